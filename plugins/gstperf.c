@@ -21,7 +21,48 @@
  *
  * Perf plugin can be used to capture pipeline performance data.  Each
  * second perf plugin sends frames per second and bits per second data
- * using gst_element_post_message.
+ * using gst_element_post_message. Both are measured over the same
+ * window and reported even when no buffers flow, so a stalled stream
+ * reports zero.
+ *
+ * With print-media-time the same frames and bytes are also divided by the
+ * running time their timestamps cover, which gives the rates of the
+ * content rather than of the transport, and the realtime factor tells how
+ * many media seconds went through per wall clock second.
+ *
+ * With print-caps-rates the negotiated caps are parsed as they arrive and
+ * each report compares the measured fps with the nominal framerate, and
+ * gives the pixel rate of raw video or the sample rate of raw audio.
+ * After an encoder, print-compression looks upstream for the raw video
+ * caps and reports the bits per pixel and the compression ratio.
+ *
+ * print-backpressure times every push downstream. If the streaming thread
+ * spends most of its time blocked in there the element after perf is the
+ * bottleneck, if it mostly waits for buffers the one before is.
+ *
+ * Setting recorder-size keeps a flight recorder of the last buffers:
+ * arrival time, PTS, size, flags and thread CPU time. It is dumped to a
+ * binary file, described in gstperfrecorder.h, when the fps drops below
+ * recorder-min-fps, when two buffers are further apart than
+ * recorder-max-gap, on the "dump" action signal or, with
+ * recorder-sigusr1, when the process receives SIGUSR1.
+ *
+ * With shm-export every report is also copied into a slot of the shared
+ * memory segment of the process, /dev/shm/gst-perf-<pid>, so a monitoring
+ * agent can read all the instances without debug logs or bus messages.
+ * The layout is described in gstperfshm.h.
+ *
+ * By default the data is formatted as a string in a GST_MESSAGE_INFO.
+ * Setting message-format=element posts a GST_MESSAGE_ELEMENT instead,
+ * carrying a "perf" GstStructure with the values as native types.
+ *
+ * Two perf elements can measure the latency of the section between them:
+ * the one with latency-role=ingress attaches a GstPerfMeta with the
+ * arrival time to every buffer, the one with latency-role=egress reports
+ * the distribution of the time elapsed since.
+ *
+ * The read-only stats property returns the same structure for the last
+ * report and can be polled from any thread without blocking streaming.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -29,16 +70,30 @@
 #endif
 
 #include "gstperf.h"
+#include "gstperfatomic.h"
+#include "gstperfbin.h"
+#include "gstperfhistogram.h"
+#include "gstperfmeta.h"
+#include "gstperfrecorder.h"
+#include "gstperfsampler.h"
+#include "gstperfshm.h"
+#include "gstperftracer.h"
+#include "gstperfutils.h"
+
+#ifdef HAVE_SCHED_GETCPU
+#  include <sched.h>
+#endif
 
-#ifdef IS_MACOSX
-#  include <mach/mach_init.h>
-#  include <mach/mach_error.h>
-#  include <mach/mach_host.h>
-#  include <mach/vm_map.h>
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+#  include <pthread.h>
 #endif
 
+#include <gst/audio/audio.h>
+#include <gst/video/video.h>
+
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 /* pad templates */
 static GstStaticPadTemplate gst_perf_src_template =
@@ -54,12 +109,30 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_STATIC_CAPS_ANY);
 
 
-GST_DEBUG_CATEGORY_STATIC (gst_perf_debug);
+GST_DEBUG_CATEGORY (gst_perf_debug);
 #define GST_CAT_DEFAULT gst_perf_debug
 
 #define DEFAULT_PRINT_CPU_LOAD    FALSE
+#define DEFAULT_PRINT_JITTER    FALSE
+#define DEFAULT_PRINT_THREAD_CPU    FALSE
+#define DEFAULT_PRINT_CORE_LOAD    FALSE
+#define DEFAULT_PRINT_MEMORY       FALSE
+#define DEFAULT_PRINT_HORIZONS     FALSE
+#define DEFAULT_LATENCY_ROLE    GST_PERF_LATENCY_ROLE_NONE
 #define DEFAULT_BITRATE_WINDOW_SIZE    0
 #define DEFAULT_BITRATE_INTERVAL    1000
+#define DEFAULT_MESSAGE_FORMAT    GST_PERF_MESSAGE_FORMAT_INFO
+#define DEFAULT_STALL_TIMEOUT    0
+#define DEFAULT_PRINT_MEDIA_TIME    FALSE
+#define DEFAULT_PRINT_CAPS_RATES    FALSE
+#define DEFAULT_PRINT_COMPRESSION    FALSE
+#define DEFAULT_PRINT_BACKPRESSURE    FALSE
+#define DEFAULT_RECORDER_SIZE    0
+#define DEFAULT_RECORDER_LOCATION    NULL
+#define DEFAULT_RECORDER_MIN_FPS    0.0
+#define DEFAULT_RECORDER_MAX_GAP    0
+#define DEFAULT_RECORDER_SIGUSR1    FALSE
+#define DEFAULT_SHM_EXPORT    FALSE
 
 enum
 {
@@ -67,27 +140,163 @@ enum
   PROP_PRINT_ARM_LOAD,
   PROP_PRINT_CPU_LOAD,
   PROP_BITRATE_WINDOW_SIZE,
-  PROP_BITRATE_INTERVAL
+  PROP_BITRATE_INTERVAL,
+  PROP_MESSAGE_FORMAT,
+  PROP_PRINT_JITTER,
+  PROP_LATENCY_ROLE,
+  PROP_PRINT_THREAD_CPU,
+  PROP_PRINT_CORE_LOAD,
+  PROP_PRINT_MEMORY,
+  PROP_STATS,
+  PROP_PRINT_HORIZONS,
+  PROP_STALL_TIMEOUT,
+  PROP_PRINT_MEDIA_TIME,
+  PROP_PRINT_CAPS_RATES,
+  PROP_PRINT_COMPRESSION,
+  PROP_PRINT_BACKPRESSURE,
+  PROP_RECORDER_SIZE,
+  PROP_RECORDER_LOCATION,
+  PROP_RECORDER_MIN_FPS,
+  PROP_RECORDER_MAX_GAP,
+  PROP_RECORDER_SIGUSR1,
+  PROP_SHM_EXPORT
 };
 
+typedef enum
+{
+  GST_PERF_MESSAGE_FORMAT_INFO,
+  GST_PERF_MESSAGE_FORMAT_ELEMENT
+} GstPerfMessageFormat;
+
+#define GST_TYPE_PERF_MESSAGE_FORMAT (gst_perf_message_format_get_type ())
+static GType
+gst_perf_message_format_get_type (void)
+{
+  static GType message_format_type = 0;
+  static const GEnumValue message_formats[] = {
+    {GST_PERF_MESSAGE_FORMAT_INFO,
+        "Formatted string in a GST_MESSAGE_INFO", "info"},
+    {GST_PERF_MESSAGE_FORMAT_ELEMENT,
+        "Typed GstStructure in a GST_MESSAGE_ELEMENT", "element"},
+    {0, NULL, NULL}
+  };
+
+  if (!message_format_type) {
+    message_format_type =
+        g_enum_register_static ("GstPerfMessageFormat", message_formats);
+  }
+  return message_format_type;
+}
+
+typedef enum
+{
+  GST_PERF_LATENCY_ROLE_NONE,
+  GST_PERF_LATENCY_ROLE_INGRESS,
+  GST_PERF_LATENCY_ROLE_EGRESS
+} GstPerfLatencyRole;
+
+#define GST_TYPE_PERF_LATENCY_ROLE (gst_perf_latency_role_get_type ())
+static GType
+gst_perf_latency_role_get_type (void)
+{
+  static GType latency_role_type = 0;
+  static const GEnumValue latency_roles[] = {
+    {GST_PERF_LATENCY_ROLE_NONE, "Don't measure latency", "none"},
+    {GST_PERF_LATENCY_ROLE_INGRESS,
+        "Stamp buffers for a downstream egress perf", "ingress"},
+    {GST_PERF_LATENCY_ROLE_EGRESS,
+        "Measure latency from an upstream ingress perf", "egress"},
+    {0, NULL, NULL}
+  };
+
+  if (!latency_role_type) {
+    latency_role_type =
+        g_enum_register_static ("GstPerfLatencyRole", latency_roles);
+  }
+  return latency_role_type;
+}
+
+/* Values gathered for a single report */
+typedef struct _GstPerfReport
+{
+  GstClockTime timestamp;
+  gdouble fps;
+  gdouble mean_fps;
+  gdouble bps;
+  gdouble mean_bps;
+  gboolean has_cpu_load;
+  gint cpu_load;
+  gboolean has_jitter;
+  GstPerfHistogramStats gap;
+  GstPerfHistogramStats run_gap;
+  gboolean has_latency;
+  GstPerfHistogramStats latency;
+  GstPerfHistogramStats run_latency;
+  gboolean has_thread_cpu;
+  GstClockTime thread_cpu_time;
+  GstClockTime process_cpu_time;
+  gdouble thread_cpu;
+  gdouble process_cpu;
+  gboolean has_core;
+  gint core;
+  guint32 migrations;
+  guint n_cores;
+  const gint *core_load;
+  gboolean has_memory;
+  guint64 rss;
+  guint64 mem_total;
+  guint64 mem_available;
+  gboolean has_horizons;
+  GstPerfEwma fps_horizons;
+  GstPerfEwma bps_horizons;
+  GstPerfEwma cpu_horizons;
+  gdouble mean_cpu;
+  gboolean has_media_time;
+  GstClockTime media_time;
+  gdouble media_fps;
+  gdouble media_bps;
+  gdouble realtime_factor;
+  gboolean has_nominal_fps;
+  gdouble nominal_fps;
+  gdouble dropped_fps;
+  gboolean has_pixels;
+  gdouble mpixels_per_second;
+  gboolean has_samples;
+  gdouble samples_per_second;
+  gboolean has_compression;
+  gdouble bits_per_pixel;
+  gdouble compression_ratio;
+  gboolean has_backpressure;
+  GstClockTime blocked_time;
+  GstClockTime idle_time;
+  gdouble backpressure;
+} GstPerfReport;
+
+typedef struct _GstPerfLastBuffer
+{
+  GstClockTime arrival;
+  GstClockTime pts;
+} GstPerfLastBuffer;
+
 /* GstPerf signals and args */
 enum
 {
   SIGNAL_ON_BITRATE,
+  SIGNAL_DUMP,
   LAST_SIGNAL
 };
 
 struct _GstPerf
 {
-  GstBaseTransform parent;
+  GstElement parent;
 
   GstPad *sinkpad;
   GstPad *srcpad;
   GError *error;
 
-  GstClockTime prev_timestamp;
   gdouble fps;
-  guint32 frame_count;
+  /* Accumulated by the streaming thread, drained atomically by the timer */
+  guint64 frame_count;
   guint64 frame_count_total;
 
   gdouble bps;
@@ -95,60 +304,221 @@ struct _GstPerf
   gdouble *bps_window_buffer;
   guint32 bps_window_size;
   guint32 bps_window_buffer_current;
+  /* Accumulated by the streaming thread, drained atomically by the timer */
   guint64 byte_count;
   guint64 byte_count_total;
   guint bps_interval;
   guint bps_running_interval;
-  GMutex byte_count_mutex;
-  GMutex bps_mutex;
-  GMutex mean_bps_mutex;
-  guint bps_source_id;
 
-  guint32 prev_cpu_total;
-  guint32 prev_cpu_idle;
+  /* Averages over several horizons, owned by the timer */
+  GstPerfEwma fps_horizons;
+  GstPerfEwma bps_horizons;
+  GstPerfEwma cpu_horizons;
+  gdouble mean_cpu;
+  guint64 cpu_count;
+  /* Timestamp of the last CPU sample fed to the averages */
+  GstClockTime cpu_timestamp;
+
+  /* Statistics and report timer, independent of any main loop */
+  GstPerfTicker *ticker;
+
+  /* Process wide system sampler, taken on first use by the timer */
+  GstPerfSampler *sampler;
+
+  /*
+   * Streaming thread tracking for print-thread-cpu. current_core is owned
+   * by the streaming thread and published in last_core, migrations is
+   * drained atomically by the timer.
+   */
+  gboolean track_thread;
+  gint current_core;
+  gint last_core;
+  guint64 migrations;
+
+  /* Inter-arrival gaps, only allocated when print-jitter is set */
+  GstClockTime last_arrival;
+  GstPerfHistogram *gap_histogram;
+  GstPerfHistogram *gap_snapshot;
+  GstPerfHistogram *gap_reported;
+
+  /* Latency between paired perf elements through GstPerfMeta */
+  GstPerfLatencyRole latency_running_role;
+  GQuark latency_id;
+  guint64 latency_seqnum;
+  GstPerfHistogram *latency_histogram;
+  GstPerfHistogram *latency_snapshot;
+  GstPerfHistogram *latency_reported;
+
+  /*
+   * The streaming thread publishes its CPU clock whenever it changes
+   * (cpu_thread is its own), protected by thread_mutex.
+   */
+  guint cpu_thread;
+  GMutex thread_mutex;
+  guint thread_serial;
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  clockid_t thread_clock;
+  gboolean thread_clock_valid;
+#endif
+
+  /* CPU times at the last report, owned by the timer */
+  guint prev_thread_serial;
+  GstClockTime prev_thread_cpu_time;
+  GstClockTime prev_process_cpu_time;
+
+  /*
+   * Stall watchdog. The streaming thread records the last buffer under
+   * last_buffer_seqlock, the watchdog timer owns the rest.
+   */
+  GstClockTime stall_running_timeout;
+  GstPerfTicker *watchdog;
+  GstPerfLastBuffer last_buffer;
+  guint last_buffer_seqlock;
+  GstClockTime stall_arrival;
+
+  /*
+   * Media time for print-media-time. The segment and media_end are owned
+   * by the streaming thread, media_duration is drained by the timer.
+   */
+  gboolean track_media;
+  GstSegment segment;
+  GstClockTime media_end;
+  guint64 media_duration;
+
+  /*
+   * Downstream backpressure for print-backpressure. push_end is owned by
+   * the streaming thread, the times are drained atomically by the timer.
+   */
+  gboolean track_push;
+  GstClockTime push_end;
+  guint64 blocked_time;
+  guint64 idle_time;
+
+  /*
+   * Flight recorder. The ring is written by the streaming thread, the
+   * timer checks the triggers and dumps it. recorder_trigger collects the
+   * trigger bits from any thread.
+   */
+  GstPerfRecorder *recorder;
+  GstClockTime recorder_running_max_gap;
+  gdouble recorder_running_min_fps;
+  gboolean recorder_running_sigusr1;
+  gchar *recorder_running_location;
+  guint recorder_trigger;
+  guint recorder_signals;
+  gboolean recorder_below;
+  guint recorder_dumps;
+
+  /* Slot of the shared memory export, written only by the timer */
+  GstPerfShmSlot *shm_slot;
+
+  /*
+   * What the negotiated caps promise, protected by the object lock. A
+   * framerate of 0 is variable or unknown, 0 pixels or bytes per frame
+   * means the caps are not raw video or raw audio respectively.
+   */
+  gint caps_fps_n;
+  gint caps_fps_d;
+  guint64 caps_pixels;
+  gint caps_bpf;
+  /* Frames before compression, 0 if no raw video caps were found */
+  guint64 caps_raw_pixels;
+  guint64 caps_raw_size;
+
+  /*
+   * Copy of the last report for the stats property. Written only by the
+   * timer, readers go through the stats_seqlock.
+   */
+  GstPerfReport stats;
+  guint stats_seqlock;
 
   /* Properties */
   gboolean print_cpu_load;
+  GstPerfMessageFormat message_format;
+  gboolean print_jitter;
+  GstPerfLatencyRole latency_role;
+  gboolean print_thread_cpu;
+  gboolean print_core_load;
+  gboolean print_memory;
+  gboolean print_horizons;
+  guint stall_timeout;
+  gboolean print_media_time;
+  gboolean print_caps_rates;
+  gboolean print_compression;
+  gboolean print_backpressure;
+  guint recorder_size;
+  gchar *recorder_location;
+  gdouble recorder_min_fps;
+  guint recorder_max_gap;
+  gboolean recorder_sigusr1;
+  gboolean shm_export;
 };
 
 struct _GstPerfClass
 {
-  GstBaseTransformClass parent_class;
+  GstElementClass parent_class;
+
+  /* actions */
+  void (*dump) (GstPerf * perf);
 };
 
     /* class initialization */
 #define gst_perf_parent_class parent_class
-G_DEFINE_TYPE (GstPerf, gst_perf, GST_TYPE_BASE_TRANSFORM);
+G_DEFINE_TYPE (GstPerf, gst_perf, GST_TYPE_ELEMENT);
+
+/* Initial size of the text report, it grows with the enabled fields */
+#define GST_PERF_MSG_SIZE 4096
 
-/* The message is variable length depending on configuration */
-#define GST_PERF_MSG_MAX_SIZE 4096
+/* Enough for the structure field names we build */
+#define GST_PERF_FIELD_MAX_SIZE 32
 
 #define GST_PERF_BITS_PER_BYTE 8
 
-#define GST_PERF_MS_PER_S 1000.0
+/* How far upstream to look for raw video caps */
+#define GST_PERF_MAX_UPSTREAM_HOPS 16
 
 /* prototypes */
 static void gst_perf_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_perf_get_property (GObject * object, guint property_id,
     GValue * value, GParamSpec * pspec);
+static void gst_perf_finalize (GObject * object);
 
-static GstFlowReturn gst_perf_transform_ip (GstBaseTransform * trans,
+static GstStateChangeReturn gst_perf_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean gst_perf_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event);
+static GstFlowReturn gst_perf_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buf);
-static gboolean gst_perf_start (GstBaseTransform * trans);
-static gboolean gst_perf_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_perf_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list);
+static void gst_perf_account (GstPerf * perf, GstClockTime time,
+    GstClockTime pts, guint frames, guint64 bytes);
+static void gst_perf_account_media (GstPerf * perf, GstBuffer * buf);
+static void gst_perf_record (GstPerf * perf, GstClockTime time,
+    GstBuffer * buf);
+static void gst_perf_dump (GstPerf * perf);
+static void gst_perf_check_recorder (GstPerf * perf, gdouble fps);
+static void gst_perf_set_caps (GstPerf * perf, GstCaps * caps);
+static void gst_perf_account_push (GstPerf * perf, GstClockTime arrival,
+    GstClockTime start);
+static gboolean gst_perf_start (GstPerf * perf);
+static gboolean gst_perf_stop (GstPerf * perf);
 
 static void gst_perf_reset (GstPerf * perf);
 static void gst_perf_clear (GstPerf * perf);
-static gdouble gst_perf_update_average (guint64 count, gdouble current,
-    gdouble old);
-static double
-gst_perf_update_moving_average (guint64 window_size, gdouble old_average,
-    gdouble new_sample, gdouble old_sample);
-static gboolean gst_perf_update_bps (void *data);
-static gboolean gst_perf_cpu_get_load (GstPerf * perf, guint32 * cpu_load);
-static guint32 gst_perf_compute_cpu (GstPerf * perf, guint32 idle,
-    guint32 total);
+static void gst_perf_tick (gpointer data, GstClockTime elapsed);
+static void gst_perf_watchdog (gpointer data, GstClockTime elapsed);
+static void gst_perf_sample_thread_cpu (GstPerf * perf,
+    GstPerfReport * report, GstClockTime elapsed);
+static GstStructure *gst_perf_report_to_structure (const GstPerfReport *
+    report);
+static void gst_perf_post_report (GstPerf * perf, const GstPerfReport * report);
+static void gst_perf_publish_stats (GstPerf * perf,
+    const GstPerfReport * report);
+static void gst_perf_publish_shm (GstPerf * perf,
+    const GstPerfReport * report);
+static GstStructure *gst_perf_get_stats (GstPerf * perf);
 
 static guint gst_perf_signals[LAST_SIGNAL] = { 0 };
 
@@ -157,11 +527,10 @@ gst_perf_class_init (GstPerfClass * klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
-  GstBaseTransformClass *base_transform_class =
-      GST_BASE_TRANSFORM_CLASS (klass);
 
   gobject_class->set_property = gst_perf_set_property;
   gobject_class->get_property = gst_perf_get_property;
+  gobject_class->finalize = gst_perf_finalize;
 
   g_object_class_install_property (gobject_class, PROP_PRINT_ARM_LOAD,
       g_param_spec_boolean ("print-arm-load", "Print arm load (deprecated)",
@@ -170,29 +539,156 @@ gst_perf_class_init (GstPerfClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_PRINT_CPU_LOAD,
       g_param_spec_boolean ("print-cpu-load", "Print CPU load",
-          "Print the CPU load info.", DEFAULT_PRINT_CPU_LOAD,
-          G_PARAM_WRITABLE));
+          "Print the CPU load info. The load is sampled once per second for "
+          "all the instances, shorter intervals repeat the last sample",
+          DEFAULT_PRINT_CPU_LOAD,
+          G_PARAM_READWRITE));
 
   g_object_class_install_property (gobject_class, PROP_BITRATE_WINDOW_SIZE,
       g_param_spec_uint ("bitrate-window-size",
           "Bitrate moving average window size",
           "Number of samples used for bitrate moving average window size, 0 is all samples",
-          0, G_MAXINT, DEFAULT_BITRATE_WINDOW_SIZE, G_PARAM_WRITABLE));
+          0, G_MAXINT, DEFAULT_BITRATE_WINDOW_SIZE, G_PARAM_READWRITE));
 
   g_object_class_install_property (gobject_class, PROP_BITRATE_INTERVAL,
       g_param_spec_uint ("bitrate-interval",
-          "Interval between bitrate calculation in ms",
-          "Interval between two calculations in ms, this will run even when no buffers are received",
-          0, G_MAXINT, DEFAULT_BITRATE_INTERVAL, G_PARAM_WRITABLE));
+          "Interval between reports in ms",
+          "Interval between two reports in ms, fps and bitrate are computed "
+          "over the same window and reported even when no buffers are "
+          "received, 0 uses the default", 0, G_MAXINT,
+          DEFAULT_BITRATE_INTERVAL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MESSAGE_FORMAT,
+      g_param_spec_enum ("message-format", "Message format",
+          "How the measurements are posted on the bus. \"element\" skips "
+          "the string formatting and posts the values as native types",
+          GST_TYPE_PERF_MESSAGE_FORMAT, DEFAULT_MESSAGE_FORMAT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_JITTER,
+      g_param_spec_boolean ("print-jitter", "Print jitter",
+          "Print the distribution of the gaps between buffer arrivals, per "
+          "interval and for the whole run (in ms, in ns in element messages)",
+          DEFAULT_PRINT_JITTER, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY_ROLE,
+      g_param_spec_enum ("latency-role", "Latency role",
+          "An ingress perf stamps the buffers, a downstream egress perf "
+          "reports the latency since they went through the ingress",
+          GST_TYPE_PERF_LATENCY_ROLE, DEFAULT_LATENCY_ROLE,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_THREAD_CPU,
+      g_param_spec_boolean ("print-thread-cpu", "Print thread CPU",
+          "Print the CPU used by the streaming thread and by the whole "
+          "process, in percent of one core, and the core the streaming "
+          "thread runs on with the number of migrations between cores",
+          DEFAULT_PRINT_THREAD_CPU, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_CORE_LOAD,
+      g_param_spec_boolean ("print-core-load", "Print core load",
+          "Print the load of every CPU core, requires print-cpu-load",
+          DEFAULT_PRINT_CORE_LOAD, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_MEMORY,
+      g_param_spec_boolean ("print-memory", "Print memory",
+          "Print the resident memory of the process and the total and "
+          "available memory of the system", DEFAULT_PRINT_MEMORY,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "The last report, safe to poll from any thread",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_HORIZONS,
+      g_param_spec_boolean ("print-horizons", "Print horizons",
+          "Print fps, bitrate and CPU load averaged over the last 1, 10 "
+          "and 60 seconds, plus the lifetime CPU load",
+          DEFAULT_PRINT_HORIZONS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STALL_TIMEOUT,
+      g_param_spec_uint ("stall-timeout", "Stall timeout in ms",
+          "Post a warning when no buffer passed for this long once the "
+          "stream started, 0 disables the watchdog", 0, G_MAXUINT,
+          DEFAULT_STALL_TIMEOUT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_MEDIA_TIME,
+      g_param_spec_boolean ("print-media-time", "Print media time",
+          "Also compute fps and bitrate over the media time the buffers "
+          "cover in running time, and print the realtime factor: media "
+          "seconds processed per wall clock second",
+          DEFAULT_PRINT_MEDIA_TIME, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_CAPS_RATES,
+      g_param_spec_boolean ("print-caps-rates", "Print caps rates",
+          "Compare the measured rates with the negotiated caps: nominal "
+          "fps and frames dropped per second, plus Mpixel/s for raw video "
+          "and samples/s for raw audio", DEFAULT_PRINT_CAPS_RATES,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_COMPRESSION,
+      g_param_spec_boolean ("print-compression", "Print compression",
+          "Print the bits per pixel and the compression ratio against the "
+          "closest raw video caps found upstream, e.g. before an encoder",
+          DEFAULT_PRINT_COMPRESSION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_PRINT_BACKPRESSURE,
+      g_param_spec_boolean ("print-backpressure", "Print backpressure",
+          "Print the time spent blocked pushing downstream and idle waiting "
+          "for upstream, and the share of the first: close to 1 downstream "
+          "is the bottleneck, close to 0 upstream is",
+          DEFAULT_PRINT_BACKPRESSURE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_RECORDER_SIZE,
+      g_param_spec_uint ("recorder-size", "Flight recorder size",
+          "Number of buffers the flight recorder keeps, e.g. the framerate "
+          "times the seconds to look back, 0 disables it", 0,
+          GST_PERF_RECORDER_MAX_SIZE, DEFAULT_RECORDER_SIZE,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_RECORDER_LOCATION,
+      g_param_spec_string ("recorder-location", "Flight recorder location",
+          "Prefix of the dump files, followed by the element name and the "
+          "dump number. NULL dumps to the temporary directory",
+          DEFAULT_RECORDER_LOCATION, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_RECORDER_MIN_FPS,
+      g_param_spec_double ("recorder-min-fps", "Flight recorder minimum fps",
+          "Dump the flight recorder when the fps of an interval drops below "
+          "this, once per drop, 0 disables the trigger", 0, G_MAXDOUBLE,
+          DEFAULT_RECORDER_MIN_FPS, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_RECORDER_MAX_GAP,
+      g_param_spec_uint ("recorder-max-gap", "Flight recorder maximum gap",
+          "Dump the flight recorder when two buffers arrive further apart "
+          "than this many ms, 0 disables the trigger", 0, G_MAXUINT,
+          DEFAULT_RECORDER_MAX_GAP, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_RECORDER_SIGUSR1,
+      g_param_spec_boolean ("recorder-sigusr1", "Flight recorder on SIGUSR1",
+          "Dump the flight recorder when the process receives SIGUSR1. The "
+          "handler is installed for the whole process on start",
+          DEFAULT_RECORDER_SIGUSR1, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SHM_EXPORT,
+      g_param_spec_boolean ("shm-export", "Shared memory export",
+          "Publish every report in a slot of the shared memory segment of "
+          "the process, /dev/shm/gst-perf-<pid>, for external monitoring",
+          DEFAULT_SHM_EXPORT, G_PARAM_READWRITE));
 
   gst_perf_signals[SIGNAL_ON_BITRATE] =
       g_signal_new ("on-bitrate", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_DOUBLE);
 
-  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_perf_start);
-  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_perf_stop);
-  base_transform_class->transform_ip =
-      GST_DEBUG_FUNCPTR (gst_perf_transform_ip);
+  gst_perf_signals[SIGNAL_DUMP] =
+      g_signal_new ("dump", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION, G_STRUCT_OFFSET (GstPerfClass,
+          dump), NULL, NULL, NULL, G_TYPE_NONE, 0);
+
+  klass->dump = GST_DEBUG_FUNCPTR (gst_perf_dump);
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_perf_change_state);
 
   gst_element_class_set_static_metadata (element_class,
       "Performance Identity element", "Generic",
@@ -215,13 +711,62 @@ gst_perf_init (GstPerf * perf)
   perf->bps_interval = DEFAULT_BITRATE_INTERVAL;
   perf->bps_running_interval = DEFAULT_BITRATE_INTERVAL;
   perf->bps_window_buffer_current = 0;
+  perf->message_format = DEFAULT_MESSAGE_FORMAT;
+  perf->print_jitter = DEFAULT_PRINT_JITTER;
+  perf->latency_role = DEFAULT_LATENCY_ROLE;
+  perf->latency_running_role = DEFAULT_LATENCY_ROLE;
+  perf->print_thread_cpu = DEFAULT_PRINT_THREAD_CPU;
+  perf->print_core_load = DEFAULT_PRINT_CORE_LOAD;
+  perf->print_memory = DEFAULT_PRINT_MEMORY;
+  perf->print_horizons = DEFAULT_PRINT_HORIZONS;
+  perf->stall_timeout = DEFAULT_STALL_TIMEOUT;
+  perf->print_media_time = DEFAULT_PRINT_MEDIA_TIME;
+  perf->print_caps_rates = DEFAULT_PRINT_CAPS_RATES;
+  perf->print_compression = DEFAULT_PRINT_COMPRESSION;
+  perf->print_backpressure = DEFAULT_PRINT_BACKPRESSURE;
+  perf->recorder_size = DEFAULT_RECORDER_SIZE;
+  perf->recorder_location = DEFAULT_RECORDER_LOCATION;
+  perf->recorder_min_fps = DEFAULT_RECORDER_MIN_FPS;
+  perf->recorder_max_gap = DEFAULT_RECORDER_MAX_GAP;
+  perf->recorder_sigusr1 = DEFAULT_RECORDER_SIGUSR1;
+  perf->shm_export = DEFAULT_SHM_EXPORT;
+
+  g_mutex_init (&perf->thread_mutex);
+
+  /*
+   * Buffers are only observed, so caps, allocation and scheduling queries
+   * are proxied and events take the default path once looked at.
+   */
+  perf->sinkpad =
+      gst_pad_new_from_static_template (&gst_perf_sink_template, "sink");
+  gst_pad_set_event_function (perf->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_perf_sink_event));
+  gst_pad_set_chain_function (perf->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_perf_chain));
+  gst_pad_set_chain_list_function (perf->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_perf_chain_list));
+  GST_PAD_SET_PROXY_CAPS (perf->sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (perf->sinkpad);
+  GST_PAD_SET_PROXY_SCHEDULING (perf->sinkpad);
+  gst_element_add_pad (GST_ELEMENT (perf), perf->sinkpad);
+
+  perf->srcpad =
+      gst_pad_new_from_static_template (&gst_perf_src_template, "src");
+  GST_PAD_SET_PROXY_CAPS (perf->srcpad);
+  GST_PAD_SET_PROXY_ALLOCATION (perf->srcpad);
+  GST_PAD_SET_PROXY_SCHEDULING (perf->srcpad);
+  gst_element_add_pad (GST_ELEMENT (perf), perf->srcpad);
+}
+
+static void
+gst_perf_finalize (GObject * object)
+{
+  GstPerf *perf = GST_PERF (object);
 
-  g_mutex_init (&perf->byte_count_mutex);
-  g_mutex_init (&perf->bps_mutex);
-  g_mutex_init (&perf->mean_bps_mutex);
+  g_free (perf->recorder_location);
+  g_mutex_clear (&perf->thread_mutex);
 
-  gst_base_transform_set_gap_aware (GST_BASE_TRANSFORM_CAST (perf), TRUE);
-  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM_CAST (perf), TRUE);
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 void
@@ -249,6 +794,97 @@ gst_perf_set_property (GObject * object, guint property_id,
       perf->bps_interval = g_value_get_uint (value);
       GST_OBJECT_UNLOCK (perf);
       break;
+    case PROP_MESSAGE_FORMAT:
+      GST_OBJECT_LOCK (perf);
+      perf->message_format = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_JITTER:
+      GST_OBJECT_LOCK (perf);
+      perf->print_jitter = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_LATENCY_ROLE:
+      GST_OBJECT_LOCK (perf);
+      perf->latency_role = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_THREAD_CPU:
+      GST_OBJECT_LOCK (perf);
+      perf->print_thread_cpu = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_CORE_LOAD:
+      GST_OBJECT_LOCK (perf);
+      perf->print_core_load = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_MEMORY:
+      GST_OBJECT_LOCK (perf);
+      perf->print_memory = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_HORIZONS:
+      GST_OBJECT_LOCK (perf);
+      perf->print_horizons = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_STALL_TIMEOUT:
+      GST_OBJECT_LOCK (perf);
+      perf->stall_timeout = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_MEDIA_TIME:
+      GST_OBJECT_LOCK (perf);
+      perf->print_media_time = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_CAPS_RATES:
+      GST_OBJECT_LOCK (perf);
+      perf->print_caps_rates = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_COMPRESSION:
+      GST_OBJECT_LOCK (perf);
+      perf->print_compression = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_BACKPRESSURE:
+      GST_OBJECT_LOCK (perf);
+      perf->print_backpressure = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_SIZE:
+      GST_OBJECT_LOCK (perf);
+      perf->recorder_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_LOCATION:
+      GST_OBJECT_LOCK (perf);
+      g_free (perf->recorder_location);
+      perf->recorder_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_MIN_FPS:
+      GST_OBJECT_LOCK (perf);
+      perf->recorder_min_fps = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_MAX_GAP:
+      GST_OBJECT_LOCK (perf);
+      perf->recorder_max_gap = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_SIGUSR1:
+      GST_OBJECT_LOCK (perf);
+      perf->recorder_sigusr1 = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_SHM_EXPORT:
+      GST_OBJECT_LOCK (perf);
+      perf->shm_export = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (perf);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -280,37 +916,119 @@ gst_perf_get_property (GObject * object, guint property_id,
       g_value_set_uint (value, perf->bps_interval);
       GST_OBJECT_UNLOCK (perf);
       break;
+    case PROP_MESSAGE_FORMAT:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_enum (value, perf->message_format);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_JITTER:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_jitter);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_LATENCY_ROLE:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_enum (value, perf->latency_role);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_THREAD_CPU:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_thread_cpu);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_CORE_LOAD:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_core_load);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_MEMORY:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_memory);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_HORIZONS:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_horizons);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_perf_get_stats (perf));
+      break;
+    case PROP_STALL_TIMEOUT:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_uint (value, perf->stall_timeout);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_MEDIA_TIME:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_media_time);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_CAPS_RATES:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_caps_rates);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_COMPRESSION:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_compression);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_PRINT_BACKPRESSURE:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->print_backpressure);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_SIZE:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_uint (value, perf->recorder_size);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_LOCATION:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_string (value, perf->recorder_location);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_MIN_FPS:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_double (value, perf->recorder_min_fps);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_MAX_GAP:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_uint (value, perf->recorder_max_gap);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_RECORDER_SIGUSR1:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->recorder_sigusr1);
+      GST_OBJECT_UNLOCK (perf);
+      break;
+    case PROP_SHM_EXPORT:
+      GST_OBJECT_LOCK (perf);
+      g_value_set_boolean (value, perf->shm_export);
+      GST_OBJECT_UNLOCK (perf);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
 }
 
-static gboolean
-gst_perf_update_bps (void *data)
+static void
+gst_perf_update_bps (GstPerf * perf, GstClockTime elapsed)
 {
   guint buffer_current_idx;
-  GstPerf *perf;
-  guint byte_count;
+  guint64 byte_count;
   gdouble bps, mean_bps;
 
-  g_return_val_if_fail (data, FALSE);
-
-  perf = GST_PERF (data);
-
-  g_mutex_lock (&perf->byte_count_mutex);
-  byte_count = perf->byte_count;
-  perf->byte_count = G_GUINT64_CONSTANT (0);
-  g_mutex_unlock (&perf->byte_count_mutex);
+  byte_count =
+      gst_perf_atomic_u64_exchange (&perf->byte_count, G_GUINT64_CONSTANT (0));
 
-  g_mutex_lock (&perf->mean_bps_mutex);
   mean_bps = perf->mean_bps;
-  g_mutex_unlock (&perf->mean_bps_mutex);
 
-  /* Calculate bits per second */
-  bps =
-      byte_count * GST_PERF_BITS_PER_BYTE / (perf->bps_running_interval /
-      GST_PERF_MS_PER_S);
+  /* Calculate bits per second over the time that actually elapsed */
+  bps = byte_count * GST_PERF_BITS_PER_BYTE / (1.0 * elapsed / GST_SECOND);
 
   /* Update bps average */
   if (!perf->bps_window_size) {
@@ -329,308 +1047,1516 @@ gst_perf_update_bps (void *data)
 
     perf->bps_window_buffer[buffer_current_idx] = bps;
   }
-  g_mutex_lock (&perf->mean_bps_mutex);
   perf->mean_bps = mean_bps;
-  g_mutex_unlock (&perf->mean_bps_mutex);
-
-  g_mutex_lock (&perf->bps_mutex);
   perf->bps = bps;
-  g_mutex_unlock (&perf->bps_mutex);
+  gst_perf_ewma_update (&perf->bps_horizons, bps, elapsed);
 
   perf->byte_count_total++;
-
-  g_signal_emit_by_name (perf, "on-bitrate", mean_bps);
-
-  return TRUE;
 }
 
-static gboolean
-gst_perf_start (GstBaseTransform * trans)
+static void
+gst_perf_tick (gpointer data, GstClockTime elapsed)
 {
-  GstPerf *perf = GST_PERF (trans);
-
-  gst_perf_clear (perf);
+  GstPerf *perf;
+  GstPerfReport report = { 0 };
+  gboolean print_core_load, print_thread_cpu, print_caps_rates;
+  gboolean print_compression;
+  GstPerfSample *sample = NULL;
+  guint64 frame_count;
+  gint core;
+  gint fps_n, fps_d, bpf;
+  guint64 pixels, raw_pixels, raw_size;
+
+  g_return_if_fail (data);
+  g_return_if_fail (elapsed);
 
-  /* If window size is different from all samples allocate the needed memory */
-  if (perf->bps_window_size) {
-    perf->bps_window_buffer =
-        g_malloc0 ((perf->bps_window_size) * sizeof (gdouble));
+  perf = GST_PERF (data);
 
-    if (!perf->bps_window_buffer) {
-      GST_ERROR_OBJECT (perf, "Unable to allocate memory");
-      return FALSE;
+  /*
+   * fps and bitrate cover exactly the same window, and a report goes out
+   * every interval even if nothing flowed so a stall shows up as zero.
+   */
+  frame_count =
+      gst_perf_atomic_u64_exchange (&perf->frame_count, G_GUINT64_CONSTANT (0));
+  gst_perf_update_bps (perf, elapsed);
+
+  report.timestamp = gst_util_get_timestamp ();
+
+  /*Calculate frames per second */
+  report.fps = frame_count / (1.0 * elapsed / GST_SECOND);
+
+  /*Update fps average */
+  perf->fps =
+      gst_perf_update_average (perf->frame_count_total, report.fps, perf->fps);
+  perf->frame_count_total++;
+
+  report.mean_fps = perf->fps;
+  report.bps = perf->bps;
+  report.mean_bps = perf->mean_bps;
+
+  /* Same frames and bytes, measured against the media time they cover */
+  if (perf->track_media) {
+    report.has_media_time = TRUE;
+    report.media_time = gst_perf_atomic_u64_exchange (&perf->media_duration,
+        G_GUINT64_CONSTANT (0));
+    report.realtime_factor = 1.0 * report.media_time / elapsed;
+
+    if (report.media_time) {
+      report.media_fps = report.fps * elapsed / report.media_time;
+      report.media_bps = report.bps * elapsed / report.media_time;
     }
   }
 
-  perf->bps_running_interval = perf->bps_interval;
+  GST_OBJECT_LOCK (perf);
+  report.has_cpu_load = perf->print_cpu_load;
+  report.has_memory = perf->print_memory;
+  report.has_horizons = perf->print_horizons;
+  print_core_load = perf->print_core_load;
+  print_thread_cpu = perf->print_thread_cpu;
+  print_caps_rates = perf->print_caps_rates;
+  print_compression = perf->print_compression;
+  fps_n = perf->caps_fps_n;
+  fps_d = perf->caps_fps_d;
+  pixels = perf->caps_pixels;
+  bpf = perf->caps_bpf;
+  raw_pixels = perf->caps_raw_pixels;
+  raw_size = perf->caps_raw_size;
+  GST_OBJECT_UNLOCK (perf);
+
+  /* Every raw video buffer is a frame, every raw audio one whole samples */
+  if (print_caps_rates) {
+    if (fps_n > 0 && fps_d > 0) {
+      report.has_nominal_fps = TRUE;
+      report.nominal_fps = 1.0 * fps_n / fps_d;
+      report.dropped_fps = MAX (report.nominal_fps - report.fps, 0.0);
+    }
 
-  perf->bps_source_id =
-      g_timeout_add (perf->bps_interval, gst_perf_update_bps, perf);
+    if (pixels) {
+      report.has_pixels = TRUE;
+      report.mpixels_per_second = report.fps * pixels / 1000000.0;
+    }
 
-  perf->error = g_error_new (GST_CORE_ERROR,
-      GST_CORE_ERROR_TAG, "Performance Information");
-  return TRUE;
-}
+    if (bpf > 0) {
+      report.has_samples = TRUE;
+      report.samples_per_second = report.bps / GST_PERF_BITS_PER_BYTE / bpf;
+    }
+  }
 
-static gboolean
-gst_perf_stop (GstBaseTransform * trans)
-{
-  GstPerf *perf = GST_PERF (trans);
+  if (perf->track_push) {
+    report.has_backpressure = TRUE;
+    report.blocked_time = gst_perf_atomic_u64_exchange (&perf->blocked_time,
+        G_GUINT64_CONSTANT (0));
+    report.idle_time = gst_perf_atomic_u64_exchange (&perf->idle_time,
+        G_GUINT64_CONSTANT (0));
 
-  gst_perf_clear (perf);
+    if (report.blocked_time + report.idle_time) {
+      report.backpressure = 1.0 * report.blocked_time /
+          (report.blocked_time + report.idle_time);
+    }
+  }
 
-  g_free (perf->bps_window_buffer);
+  /* The bitrate of this interval against what the same frames were raw */
+  if (print_compression && raw_pixels && report.fps > 0 && report.bps > 0) {
+    report.has_compression = TRUE;
+    report.bits_per_pixel = report.bps / (report.fps * raw_pixels);
+    report.compression_ratio =
+        raw_size * GST_PERF_BITS_PER_BYTE * report.fps / report.bps;
+  }
 
-  g_source_remove (perf->bps_source_id);
+  /* The properties may have been enabled after start */
+  if ((report.has_cpu_load || report.has_memory) && !perf->sampler) {
+    perf->sampler = gst_perf_sampler_acquire ();
+  }
 
-  if (perf->error)
-    g_error_free (perf->error);
+  if (perf->sampler) {
+    sample = gst_perf_sampler_get_sample (perf->sampler);
+  }
 
-  return TRUE;
-}
+  if (report.has_cpu_load) {
+    report.cpu_load = sample ? sample->cpu_load : -1;
 
-static guint32
-gst_perf_compute_cpu (GstPerf * self, guint32 current_idle,
-    guint32 current_total)
-{
-  guint32 busy = 0;
-  guint32 idle = 0;
-  guint32 total = 0;
+    if (print_core_load && sample) {
+      report.n_cores = sample->n_cores;
+      report.core_load = sample->core_load;
+    }
+  }
 
-  g_return_val_if_fail (self, -1);
+  /* Every report feeds the averages, printed or not */
+  gst_perf_ewma_update (&perf->fps_horizons, report.fps, elapsed);
+  report.fps_horizons = perf->fps_horizons;
+  report.bps_horizons = perf->bps_horizons;
 
-  /* Calculate the CPU usage since last time we checked */
-  idle = current_idle - self->prev_cpu_idle;
-  total = current_total - self->prev_cpu_total;
+  /* The sampler ticks once a second, with shorter intervals the same
+   * sample is seen several times and must only be counted once, weighted
+   * by the time it covers */
+  if (report.has_cpu_load && report.cpu_load >= 0
+      && sample->timestamp != perf->cpu_timestamp) {
+    GstClockTime covered = elapsed;
 
-  /* Update the total and idle CPU for the next check */
-  self->prev_cpu_total = current_total;
-  self->prev_cpu_idle = current_idle;
+    if (GST_CLOCK_TIME_IS_VALID (perf->cpu_timestamp)) {
+      covered = GST_CLOCK_DIFF (perf->cpu_timestamp, sample->timestamp);
+    }
+    perf->cpu_timestamp = sample->timestamp;
 
-  /* Avoid a divison by zero */
-  if (0 == total) {
-    return 0;
+    gst_perf_ewma_update (&perf->cpu_horizons, report.cpu_load, covered);
+    perf->mean_cpu = gst_perf_update_average (perf->cpu_count,
+        report.cpu_load, perf->mean_cpu);
+    perf->cpu_count++;
   }
+  report.cpu_horizons = perf->cpu_horizons;
+  report.mean_cpu = perf->mean_cpu;
 
-  /* - CPU usage is the fraction of time the processor spent busy:
-   * [0.0, 1.0].
-   *
-   * - We want to express this as a percentage [0% - 100%].
-   *
-   * - We want to avoid, when possible, using floating
-   * point operations (some SoC still don't have a FP unit).
-   *
-   * - Scaling to 1000 allows us round (nearest interger) by summing
-   * 5 and then scaling down back to 100 by dividing by
-   * 10. Othersise we would've lost the decimals due to integer
-   * truncating.
-   */
-  busy = total - idle;
-  return (1000 * busy / total + 5) / 10;
-}
-
-#ifdef IS_LINUX
-static gboolean
-gst_perf_cpu_get_load (GstPerf * perf, guint32 * cpu_load)
-{
-  gboolean cpu_load_found = FALSE;
-  guint32 user, nice, sys, idle, iowait, irq, softirq, steal;
-  guint32 total = 0;
-  gchar name[4];
-  FILE *fp;
-
-  g_return_val_if_fail (perf, FALSE);
-  g_return_val_if_fail (cpu_load, FALSE);
+  if (report.has_memory && sample) {
+    report.rss = sample->rss;
+    report.mem_total = sample->mem_total;
+    report.mem_available = sample->mem_available;
+  }
 
-  /* Default value in case of failure */
-  *cpu_load = -1;
+  if (print_thread_cpu) {
+    gst_perf_sample_thread_cpu (perf, &report, elapsed);
+  }
 
-  /* Read the overall system information */
-  fp = fopen ("/proc/stat", "r");
+  core = g_atomic_int_get (&perf->last_core);
+  if (perf->track_thread && core >= 0) {
+    report.has_core = TRUE;
+    report.core = core;
+    report.migrations = gst_perf_atomic_u64_exchange (&perf->migrations,
+        G_GUINT64_CONSTANT (0));
+  }
 
-  if (fp == NULL) {
-    GST_ERROR ("/proc/stat not found");
-    goto cpu_failed;
+  if (perf->gap_histogram) {
+    report.has_jitter = TRUE;
+    gst_perf_histogram_report (perf->gap_histogram, &perf->gap_snapshot,
+        &perf->gap_reported, &report.gap, &report.run_gap);
   }
-  /* Scan the file line by line */
-  while (fscanf (fp, "%4s %d %d %d %d %d %d %d %d", name, &user, &nice,
-          &sys, &idle, &iowait, &irq, &softirq, &steal) != EOF) {
-    if (strcmp (name, "cpu") == 0) {
-      cpu_load_found = TRUE;
-      break;
-    }
+
+  if (perf->latency_histogram) {
+    report.has_latency = TRUE;
+    gst_perf_histogram_report (perf->latency_histogram,
+        &perf->latency_snapshot, &perf->latency_reported, &report.latency,
+        &report.run_latency);
   }
 
-  fclose (fp);
+  gst_perf_post_report (perf, &report);
+  gst_perf_publish_stats (perf, &report);
 
-  if (!cpu_load_found) {
-    goto cpu_failed;
+  if (perf->shm_slot) {
+    gst_perf_publish_shm (perf, &report);
   }
-  GST_DEBUG ("CPU stats-> user: %d; nice: %d; sys: %d; idle: %d "
-      "iowait: %d; irq: %d; softirq: %d; steal: %d",
-      user, nice, sys, idle, iowait, irq, softirq, steal);
 
-  /*Calculate the total CPU time */
-  total = user + nice + sys + idle + iowait + irq + softirq + steal;
-
-  *cpu_load = gst_perf_compute_cpu (perf, idle, total);
+  if (perf->recorder) {
+    gst_perf_check_recorder (perf, report.fps);
+  }
 
-  return TRUE;
+  if (sample) {
+    gst_perf_sample_unref (sample);
+  }
 
-cpu_failed:
-  GST_ERROR_OBJECT (perf, "Failed to get the CPU load");
-  return FALSE;
+  g_signal_emit_by_name (perf, "on-bitrate", report.mean_bps);
 }
 
-#elif IS_MACOSX
-static gboolean
-gst_perf_cpu_get_load (GstPerf * perf, guint32 * cpu_load)
+/* The "dump" action, may be emitted from any thread */
+static void
+gst_perf_dump (GstPerf * perf)
 {
-  guint32 idle = 0;
-  guint32 total = 0;
-  host_cpu_load_info_data_t cpuinfo = { 0 };
-  mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+  if (!perf->recorder) {
+    GST_WARNING_OBJECT (perf, "The flight recorder is disabled");
+    return;
+  }
 
-  g_return_val_if_fail (perf, FALSE);
-  g_return_val_if_fail (cpu_load, FALSE);
+  g_atomic_int_or (&perf->recorder_trigger, GST_PERF_RECORDER_TRIGGER_ACTION);
+}
 
-  /* Default value in case of failure */
-  *cpu_load = -1;
+static void
+gst_perf_dump_recorder (GstPerf * perf, guint trigger)
+{
+  GError *error = NULL;
+  gchar *location;
+  guint64 count;
+
+  if (perf->recorder_running_location) {
+    location = g_strdup_printf ("%s-%s-%u.rec",
+        perf->recorder_running_location, GST_OBJECT_NAME (perf),
+        perf->recorder_dumps);
+  } else {
+    gchar *name = g_strdup_printf ("gstperf-%s-%u.rec",
+        GST_OBJECT_NAME (perf), perf->recorder_dumps);
 
-  if (host_statistics (mach_host_self (), HOST_CPU_LOAD_INFO,
-          (host_info_t) & cpuinfo, &count) == KERN_SUCCESS) {
-    for (int i = 0; i < CPU_STATE_MAX; i++) {
-      total += cpuinfo.cpu_ticks[i];
-    }
-    idle = cpuinfo.cpu_ticks[CPU_STATE_IDLE];
+    location = g_build_filename (g_get_tmp_dir (), name, NULL);
+    g_free (name);
+  }
+  perf->recorder_dumps++;
+
+  if (gst_perf_recorder_dump (perf->recorder, location, trigger, &count,
+          &error)) {
+    GST_INFO_OBJECT (perf, "Dumped %" G_GUINT64_FORMAT " records to %s",
+        count, location);
+
+    gst_element_post_message ((GstElement *) perf,
+        gst_message_new_element ((GstObject *) perf,
+            gst_structure_new ("perf-recorder",
+                "location", G_TYPE_STRING, location,
+                "trigger", G_TYPE_UINT, trigger,
+                "records", G_TYPE_UINT64, count, NULL)));
   } else {
-    goto cpu_failed;
+    GST_WARNING_OBJECT (perf, "Unable to dump the flight recorder: %s",
+        error->message);
+    g_error_free (error);
   }
 
-  *cpu_load = gst_perf_compute_cpu (perf, idle, total);
-
-  return TRUE;
-
-cpu_failed:
-  GST_ERROR ("Failed to get the CPU load");
-  return FALSE;
+  g_free (location);
 }
 
-#else /* Unknown OS */
-static gboolean
-gst_perf_cpu_get_load (GstPerf * perf, guint32 * cpu_load)
+/* Called by the timer, dumps outside of the streaming thread */
+static void
+gst_perf_check_recorder (GstPerf * perf, gdouble fps)
 {
-  g_return_val_if_fail (perf, FALSE);
-  g_return_val_if_fail (cpu_load, FALSE);
+  guint trigger;
 
-  *cpu_load = -1;
+  /* Only the start of a drop triggers, and only once buffers flowed */
+  if (perf->recorder_running_min_fps > 0 &&
+      gst_perf_recorder_get_count (perf->recorder)) {
+    gboolean below = fps < perf->recorder_running_min_fps;
 
-  /* Not really an error, we just don't know how to measure CPU on this OS */
-  return TRUE;
-}
-#endif
+    if (below && !perf->recorder_below) {
+      g_atomic_int_or (&perf->recorder_trigger,
+          GST_PERF_RECORDER_TRIGGER_FPS);
+    }
+    perf->recorder_below = below;
+  }
 
-static GstFlowReturn
-gst_perf_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
-{
-  GstPerf *perf = GST_PERF (trans);
-  GstClockTime time = gst_util_get_timestamp ();
-  GstClockTime diff = GST_CLOCK_DIFF (perf->prev_timestamp, time);
+  if (perf->recorder_running_sigusr1) {
+    guint signals = gst_perf_recorder_get_sigusr1_count ();
 
-  if (!GST_CLOCK_TIME_IS_VALID (perf->prev_timestamp) ||
-      (GST_CLOCK_TIME_IS_VALID (time) && diff >= GST_SECOND)) {
-    gdouble time_factor, fps;
-    guint idx;
-    gchar info[GST_PERF_MSG_MAX_SIZE];
-    gboolean print_cpu_load;
-    gdouble bps, mean_bps;
+    if (signals != perf->recorder_signals) {
+      g_atomic_int_or (&perf->recorder_trigger,
+          GST_PERF_RECORDER_TRIGGER_SIGNAL);
+      perf->recorder_signals = signals;
+    }
+  }
 
-    time_factor = 1.0 * diff / GST_SECOND;
+  trigger = g_atomic_int_and (&perf->recorder_trigger, 0);
+  if (trigger) {
+    gst_perf_dump_recorder (perf, trigger);
+  }
+}
 
-    /*Calculate frames per second */
-    fps = perf->frame_count / time_factor;
+/* Describes the element peered with @pad if it is a queue, NULL otherwise */
+static GstStructure *
+gst_perf_describe_queue (GstPad * pad)
+{
+  const gchar *levels[] = { "current-level-buffers", "current-level-bytes",
+    "current-level-time"
+  };
+  GstStructure *queue = NULL;
+  GstElement *element = NULL;
+  GstPad *peer;
+  GParamSpec *pspec;
+  guint i;
+
+  peer = gst_pad_get_peer (pad);
+  if (peer) {
+    element = gst_pad_get_parent_element (peer);
+    gst_object_unref (peer);
+  }
 
-    /*Update fps average */
-    perf->fps =
-        gst_perf_update_average (perf->frame_count_total, fps, perf->fps);
-    perf->frame_count_total++;
+  if (NULL == element) {
+    return NULL;
+  }
 
-    g_mutex_lock (&perf->bps_mutex);
-    bps = perf->bps;
-    g_mutex_unlock (&perf->bps_mutex);
+  /* queue and queue2 both expose their fill level through these */
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+          levels[0])) {
+    queue = gst_structure_new ("queue",
+        "name", G_TYPE_STRING, GST_ELEMENT_NAME (element), NULL);
 
-    g_mutex_lock (&perf->mean_bps_mutex);
-    mean_bps = perf->mean_bps;
-    g_mutex_unlock (&perf->mean_bps_mutex);
+    for (i = 0; i < G_N_ELEMENTS (levels); i++) {
+      GValue value = G_VALUE_INIT;
 
-    idx =
-        g_snprintf (info, GST_PERF_MSG_MAX_SIZE,
-        "perf: %s; timestamp: %" GST_TIME_FORMAT "; "
-        "bps: %0.03f; mean_bps: %0.03f; " "fps: %0.03f; mean_fps: %0.03f",
-        GST_OBJECT_NAME (perf), GST_TIME_ARGS (time), bps, mean_bps,
-        fps, perf->fps);
+      pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+          levels[i]);
+      if (NULL == pspec) {
+        continue;
+      }
 
-    gst_perf_reset (perf);
-    perf->prev_timestamp = time;
+      g_value_init (&value, pspec->value_type);
+      g_object_get_property (G_OBJECT (element), levels[i], &value);
+      gst_structure_take_value (queue, levels[i], &value);
+    }
+  }
 
-    GST_OBJECT_LOCK (perf);
-    print_cpu_load = perf->print_cpu_load;
-    GST_OBJECT_UNLOCK (perf);
+  gst_object_unref (element);
 
-    if (print_cpu_load) {
-      guint32 cpu_load;
-      gst_perf_cpu_get_load (perf, &cpu_load);
-      idx = g_snprintf (&info[idx], GST_PERF_MSG_MAX_SIZE - idx,
-          "; cpu: %d; ", cpu_load);
+  return queue;
+}
+
+static void
+gst_perf_post_stall (GstPerf * perf, const GstPerfLastBuffer * last,
+    GstClockTime since)
+{
+  GstStructure *details;
+  GstStructure *queue;
+  gchar *debug;
+
+  details = gst_structure_new ("perf-stall",
+      "last_pts", G_TYPE_UINT64, last->pts,
+      "since_last_buffer", G_TYPE_UINT64, since,
+      "timeout", G_TYPE_UINT64, perf->stall_running_timeout, NULL);
+
+  queue = gst_perf_describe_queue (perf->sinkpad);
+  if (queue) {
+    gst_structure_set (details, "upstream_queue", GST_TYPE_STRUCTURE, queue,
+        NULL);
+    gst_structure_free (queue);
+  }
+
+  queue = gst_perf_describe_queue (perf->srcpad);
+  if (queue) {
+    gst_structure_set (details, "downstream_queue", GST_TYPE_STRUCTURE,
+        queue, NULL);
+    gst_structure_free (queue);
+  }
+
+  debug = gst_structure_to_string (details);
+  GST_WARNING_OBJECT (perf, "Stalled: %s", debug);
+
+#if GST_CHECK_VERSION(1,10,0)
+  gst_element_message_full_with_details (GST_ELEMENT (perf),
+      GST_MESSAGE_WARNING, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+      g_strdup ("Stream stalled"), debug, __FILE__, GST_FUNCTION, __LINE__,
+      details);
+#else
+  /* No structured details before 1.10, the debug string carries them */
+  GST_ELEMENT_WARNING (perf, STREAM, FAILED, ("Stream stalled"), ("%s",
+          debug));
+  g_free (debug);
+  gst_structure_free (details);
+#endif
+}
+
+static void
+gst_perf_watchdog (gpointer data, GstClockTime elapsed)
+{
+  GstPerf *perf;
+  GstPerfLastBuffer last;
+  GstClockTime since;
+  guint sequence;
+
+  g_return_if_fail (data);
+
+  perf = GST_PERF (data);
+
+  do {
+    sequence = gst_perf_seqlock_read_begin (&perf->last_buffer_seqlock);
+    last = perf->last_buffer;
+  } while (gst_perf_seqlock_read_retry (&perf->last_buffer_seqlock, sequence));
+
+  /* Armed by the first buffer, a live source may not flow in PAUSED */
+  if (!GST_CLOCK_TIME_IS_VALID (last.arrival)) {
+    return;
+  }
+
+  since = GST_CLOCK_DIFF (last.arrival, gst_util_get_timestamp ());
+  if (since < perf->stall_running_timeout) {
+    return;
+  }
+
+  /* Warn once per stall, a new buffer re-arms the watchdog */
+  if (last.arrival == perf->stall_arrival) {
+    return;
+  }
+  perf->stall_arrival = last.arrival;
+
+  gst_perf_post_stall (perf, &last, since);
+}
+
+static gboolean
+gst_perf_start (GstPerf * perf)
+{
+  gboolean print_system, print_jitter, shm_export;
+  guint recorder_size;
+
+  gst_perf_clear (perf);
+
+  /* If window size is different from all samples allocate the needed memory */
+  if (perf->bps_window_size) {
+    perf->bps_window_buffer =
+        g_malloc0 ((perf->bps_window_size) * sizeof (gdouble));
+
+    if (!perf->bps_window_buffer) {
+      GST_ERROR_OBJECT (perf, "Unable to allocate memory");
+      return FALSE;
     }
+  }
 
-    gst_element_post_message (
-        (GstElement *) perf,
-        gst_message_new_info ((GstObject *) perf, perf->error,
-            (const gchar *) info));
+  perf->bps_running_interval = perf->bps_interval;
+
+  GST_OBJECT_LOCK (perf);
+  print_system = perf->print_cpu_load || perf->print_memory;
+  print_jitter = perf->print_jitter;
+  perf->latency_running_role = perf->latency_role;
+  perf->track_thread = perf->print_thread_cpu;
+  perf->stall_running_timeout = perf->stall_timeout * GST_MSECOND;
+  perf->track_media = perf->print_media_time;
+  perf->track_push = perf->print_backpressure;
+  recorder_size = perf->recorder_size;
+  perf->recorder_running_min_fps = perf->recorder_min_fps;
+  perf->recorder_running_max_gap = perf->recorder_max_gap * GST_MSECOND;
+  perf->recorder_running_sigusr1 = perf->recorder_sigusr1;
+  perf->recorder_running_location = g_strdup (perf->recorder_location);
+  shm_export = perf->shm_export;
+  GST_OBJECT_UNLOCK (perf);
+
+  /* Exporting is best effort, the element works without a slot */
+  if (shm_export) {
+    gchar *path = gst_object_get_path_string (GST_OBJECT (perf));
+
+    perf->shm_slot = gst_perf_shm_slot_acquire (path);
+    g_free (path);
+  }
+
+  /* Allocated up front, recording never allocates */
+  if (recorder_size) {
+    perf->recorder = gst_perf_recorder_new (recorder_size);
+
+    if (perf->recorder_running_sigusr1) {
+      gst_perf_recorder_watch_sigusr1 ();
+      perf->recorder_signals = gst_perf_recorder_get_sigusr1_count ();
+    }
+  }
+
+  /* The histograms are large, only pay for them when requested */
+  if (print_jitter) {
+    perf->gap_histogram = g_new0 (GstPerfHistogram, 1);
+    perf->gap_snapshot = g_new0 (GstPerfHistogram, 1);
+    perf->gap_reported = g_new0 (GstPerfHistogram, 1);
+  }
+
+  if (GST_PERF_LATENCY_ROLE_INGRESS == perf->latency_running_role) {
+    perf->latency_id = g_quark_from_string (GST_OBJECT_NAME (perf));
+    perf->latency_seqnum = 0;
+  } else if (GST_PERF_LATENCY_ROLE_EGRESS == perf->latency_running_role) {
+    perf->latency_histogram = g_new0 (GstPerfHistogram, 1);
+    perf->latency_snapshot = g_new0 (GstPerfHistogram, 1);
+    perf->latency_reported = g_new0 (GstPerfHistogram, 1);
+  }
+
+  if (print_system) {
+    perf->sampler = gst_perf_sampler_acquire ();
+  }
+
+  perf->error = g_error_new (GST_CORE_ERROR,
+      GST_CORE_ERROR_TAG, "Performance Information");
+
+  /* Reports are driven by the timer, it can't be disabled */
+  if (!perf->bps_running_interval) {
+    GST_WARNING_OBJECT (perf, "Bitrate interval is 0, using %d ms",
+        DEFAULT_BITRATE_INTERVAL);
+    perf->bps_running_interval = DEFAULT_BITRATE_INTERVAL;
+  }
+
+  /* Run the statistics on our own clock, no main loop is required */
+  perf->ticker = gst_perf_ticker_new ("perf-stats",
+      perf->bps_running_interval, gst_perf_tick, perf);
+  if (!perf->ticker) {
+    GST_ERROR_OBJECT (perf, "Unable to start the statistics timer");
+    gst_perf_stop (perf);
+    return FALSE;
+  }
+
+  /* Check four times per timeout so a stall is caught within 1.25 times it */
+  if (perf->stall_running_timeout) {
+    perf->watchdog = gst_perf_ticker_new ("perf-watchdog",
+        MAX (perf->stall_running_timeout / GST_MSECOND / 4, 1),
+        gst_perf_watchdog, perf);
+    if (!perf->watchdog) {
+      GST_ERROR_OBJECT (perf, "Unable to start the stall watchdog");
+      gst_perf_stop (perf);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_perf_stop (GstPerf * perf)
+{
+  if (perf->ticker) {
+    gst_perf_ticker_free (perf->ticker);
+    perf->ticker = NULL;
+  }
+
+  if (perf->watchdog) {
+    gst_perf_ticker_free (perf->watchdog);
+    perf->watchdog = NULL;
+  }
+
+  gst_perf_clear (perf);
+
+  g_free (perf->bps_window_buffer);
+  perf->bps_window_buffer = NULL;
+
+  g_free (perf->gap_histogram);
+  perf->gap_histogram = NULL;
+  g_free (perf->gap_snapshot);
+  perf->gap_snapshot = NULL;
+  g_free (perf->gap_reported);
+  perf->gap_reported = NULL;
+  g_free (perf->latency_histogram);
+  perf->latency_histogram = NULL;
+  g_free (perf->latency_snapshot);
+  perf->latency_snapshot = NULL;
+  g_free (perf->latency_reported);
+  perf->latency_reported = NULL;
+
+  if (perf->sampler) {
+    gst_perf_sampler_release (perf->sampler);
+    perf->sampler = NULL;
+  }
+
+  if (perf->recorder) {
+    gst_perf_recorder_free (perf->recorder);
+    perf->recorder = NULL;
+  }
+
+  if (perf->shm_slot) {
+    gst_perf_shm_slot_release (perf->shm_slot);
+    perf->shm_slot = NULL;
+  }
+  g_free (perf->recorder_running_location);
+  perf->recorder_running_location = NULL;
+
+  if (perf->error) {
+    g_error_free (perf->error);
+    perf->error = NULL;
+  }
+
+  return TRUE;
+}
+
+static GstClockTime
+gst_perf_get_process_cpu_time (void)
+{
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+  struct timespec ts;
+
+  if (0 == clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts)) {
+    return GST_TIMESPEC_TO_TIME (ts);
+  }
+#endif
+  return GST_CLOCK_TIME_NONE;
+}
+
+static GstClockTime
+gst_perf_get_self_cpu_time (void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+
+  if (0 == clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts)) {
+    return GST_TIMESPEC_TO_TIME (ts);
+  }
+#endif
+  return GST_CLOCK_TIME_NONE;
+}
 
-    GST_INFO_OBJECT (perf, "%s", info);
+/* Called by the streaming thread when it is not the one seen before */
+static void
+gst_perf_publish_thread (GstPerf * perf)
+{
+  g_mutex_lock (&perf->thread_mutex);
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  perf->thread_clock_valid =
+      (0 == pthread_getcpuclockid (pthread_self (), &perf->thread_clock));
+#endif
+  perf->thread_serial++;
+  g_mutex_unlock (&perf->thread_mutex);
+}
+
+/* Called from the timer, reads the streaming thread clock from outside */
+static void
+gst_perf_sample_thread_cpu (GstPerf * perf, GstPerfReport * report,
+    GstClockTime elapsed)
+{
+  GstClockTime thread_cpu_time = GST_CLOCK_TIME_NONE;
+  GstClockTime process_cpu_time = gst_perf_get_process_cpu_time ();
+  guint serial;
+
+  g_mutex_lock (&perf->thread_mutex);
+  serial = perf->thread_serial;
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  if (perf->thread_clock_valid) {
+    thread_cpu_time = gst_perf_get_thread_cpu_time (perf->thread_clock);
+  }
+#endif
+  g_mutex_unlock (&perf->thread_mutex);
+
+  /* Only compare against a sample of this same streaming thread */
+  if (serial == perf->prev_thread_serial && elapsed &&
+      GST_CLOCK_TIME_IS_VALID (thread_cpu_time) &&
+      GST_CLOCK_TIME_IS_VALID (process_cpu_time) &&
+      GST_CLOCK_TIME_IS_VALID (perf->prev_thread_cpu_time) &&
+      GST_CLOCK_TIME_IS_VALID (perf->prev_process_cpu_time)) {
+    report->has_thread_cpu = TRUE;
+    report->thread_cpu_time = thread_cpu_time;
+    report->process_cpu_time = process_cpu_time;
+    report->thread_cpu =
+        100.0 * (thread_cpu_time - perf->prev_thread_cpu_time) / elapsed;
+    report->process_cpu =
+        100.0 * (process_cpu_time - perf->prev_process_cpu_time) / elapsed;
   }
 
-  perf->frame_count++;
-  g_mutex_lock (&perf->byte_count_mutex);
-  perf->byte_count += gst_buffer_get_size (buf);
-  g_mutex_unlock (&perf->byte_count_mutex);
+  perf->prev_thread_serial = serial;
+  perf->prev_thread_cpu_time = thread_cpu_time;
+  perf->prev_process_cpu_time = process_cpu_time;
+}
 
-  return GST_FLOW_OK;
+static void
+gst_perf_handle_latency_meta (GstPerf * perf, GstBuffer * buf,
+    GstClockTime time)
+{
+  GstPerfMeta *meta = gst_buffer_get_perf_meta (buf);
+
+  if (GST_PERF_LATENCY_ROLE_INGRESS == perf->latency_running_role) {
+    /* Restamp buffers coming from an earlier ingress */
+    if (!meta) {
+      gst_buffer_add_perf_meta (buf, time, perf->latency_id,
+          perf->latency_seqnum);
+    } else {
+      meta->timestamp = time;
+      meta->id = perf->latency_id;
+      meta->seqnum = perf->latency_seqnum;
+    }
+    perf->latency_seqnum++;
+  } else if (meta && GST_CLOCK_TIME_IS_VALID (meta->timestamp) &&
+      time >= meta->timestamp) {
+    gst_perf_histogram_record (perf->latency_histogram,
+        time - meta->timestamp);
+  }
 }
 
-static gdouble
-gst_perf_update_average (guint64 count, gdouble current, gdouble old)
+static GstStateChangeReturn
+gst_perf_change_state (GstElement * element, GstStateChange transition)
 {
-  gdouble ret = 0;
+  GstPerf *perf = GST_PERF (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_perf_start (perf)) {
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    default:
+      break;
+  }
 
-  if (count != 0) {
-    ret = ((count - 1) * old + current) / count;
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (GST_STATE_CHANGE_FAILURE == ret) {
+    if (GST_STATE_CHANGE_READY_TO_PAUSED == transition) {
+      gst_perf_stop (perf);
+    }
+    return ret;
+  }
+
+  /* The pads are deactivated by now, no buffer is in flight */
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_perf_stop (perf);
+      break;
+    default:
+      break;
   }
 
   return ret;
 }
 
-static gdouble
-gst_perf_update_moving_average (guint64 window_size, gdouble old_average,
-    gdouble new_sample, gdouble old_sample)
+static gboolean
+gst_perf_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPerf *perf = GST_PERF (parent);
+
+  /* Serialized with the buffers, the streaming thread owns the segment */
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      gst_perf_set_caps (perf, caps);
+      break;
+    }
+    case GST_EVENT_SEGMENT:
+      gst_event_copy_segment (event, &perf->segment);
+      perf->media_end = GST_CLOCK_TIME_NONE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_segment_init (&perf->segment, GST_FORMAT_UNDEFINED);
+      perf->media_end = GST_CLOCK_TIME_NONE;
+      break;
+    default:
+      break;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+/*
+ * Follows the "sink" pads upstream of @pad, through encoders, parsers and
+ * other perf elements, until some negotiated raw video caps. Stops at
+ * elements without such a pad, like muxers, or after a few hops.
+ */
+static gboolean
+gst_perf_find_raw_video (GstPad * pad, GstVideoInfo * info)
 {
-  gdouble ret = 0;
+  GstPad *peer;
+  gboolean found = FALSE;
+  guint hops;
+
+  peer = gst_pad_get_peer (pad);
+
+  for (hops = 0; peer && !found && hops < GST_PERF_MAX_UPSTREAM_HOPS; hops++) {
+    GstElement *element;
+    GstPad *sinkpad = NULL;
+    GstCaps *caps;
+
+    element = gst_pad_get_parent_element (peer);
+    gst_object_unref (peer);
+    peer = NULL;
+
+    if (element) {
+      sinkpad = gst_element_get_static_pad (element, "sink");
+      gst_object_unref (element);
+    }
 
-  if (window_size != 0) {
-    ret = (old_average * window_size - old_sample + new_sample) / window_size;
+    if (NULL == sinkpad) {
+      break;
+    }
+
+    caps = gst_pad_get_current_caps (sinkpad);
+    if (caps) {
+      found = gst_video_info_from_caps (info, caps) &&
+          GST_VIDEO_FORMAT_ENCODED != GST_VIDEO_INFO_FORMAT (info);
+      gst_caps_unref (caps);
+    }
+
+    if (!found) {
+      peer = gst_pad_get_peer (sinkpad);
+    }
+    gst_object_unref (sinkpad);
+  }
+
+  if (peer) {
+    gst_object_unref (peer);
+  }
+
+  return found;
+}
+
+/* Keeps the rates promised by @caps, parsed once per negotiation */
+static void
+gst_perf_set_caps (GstPerf * perf, GstCaps * caps)
+{
+  GstVideoInfo video_info;
+  GstAudioInfo audio_info;
+  gint fps_n = 0, fps_d = 1, bpf = 0;
+  guint64 pixels = 0, raw_pixels = 0, raw_size = 0;
+  gboolean print_compression;
+
+  /* Encoded video still has a nominal framerate, only raw has pixels */
+  if (gst_video_info_from_caps (&video_info, caps)) {
+    fps_n = GST_VIDEO_INFO_FPS_N (&video_info);
+    fps_d = GST_VIDEO_INFO_FPS_D (&video_info);
+
+    if (GST_VIDEO_FORMAT_ENCODED != GST_VIDEO_INFO_FORMAT (&video_info)) {
+      pixels = (guint64) GST_VIDEO_INFO_WIDTH (&video_info) *
+          GST_VIDEO_INFO_HEIGHT (&video_info);
+    }
+  } else if (gst_audio_info_from_caps (&audio_info, caps)) {
+    bpf = GST_AUDIO_INFO_BPF (&audio_info);
+  }
+
+  GST_OBJECT_LOCK (perf);
+  print_compression = perf->print_compression;
+  GST_OBJECT_UNLOCK (perf);
+
+  /* Raw video is its own reference, anything else looks upstream */
+  if (pixels) {
+    raw_pixels = pixels;
+    raw_size = GST_VIDEO_INFO_SIZE (&video_info);
+  } else if (print_compression &&
+      gst_perf_find_raw_video (perf->sinkpad, &video_info)) {
+    raw_pixels = (guint64) GST_VIDEO_INFO_WIDTH (&video_info) *
+        GST_VIDEO_INFO_HEIGHT (&video_info);
+    raw_size = GST_VIDEO_INFO_SIZE (&video_info);
+  }
+
+  GST_DEBUG_OBJECT (perf, "Caps %" GST_PTR_FORMAT " give framerate %d/%d, "
+      "%" G_GUINT64_FORMAT " pixels and %d bytes per frame", caps, fps_n,
+      fps_d, pixels, bpf);
+
+  GST_OBJECT_LOCK (perf);
+  perf->caps_fps_n = fps_n;
+  perf->caps_fps_d = fps_d;
+  perf->caps_pixels = pixels;
+  perf->caps_bpf = bpf;
+  perf->caps_raw_pixels = raw_pixels;
+  perf->caps_raw_size = raw_size;
+  GST_OBJECT_UNLOCK (perf);
+}
+
+static GstFlowReturn
+gst_perf_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstPerf *perf = GST_PERF (parent);
+  GstClockTime time = gst_util_get_timestamp ();
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GstFlowReturn ret;
+
+  /*
+   * The ingress needs a writable buffer to attach the meta. Everybody
+   * else pushes the very same buffer it received.
+   */
+  if (GST_PERF_LATENCY_ROLE_INGRESS == perf->latency_running_role) {
+    buf = gst_buffer_make_writable (buf);
+  }
+
+  if (GST_PERF_LATENCY_ROLE_NONE != perf->latency_running_role) {
+    gst_perf_handle_latency_meta (perf, buf, time);
+  }
+
+  if (perf->track_media) {
+    gst_perf_account_media (perf, buf);
+  }
+
+  if (perf->recorder) {
+    gst_perf_record (perf, time, buf);
+  }
+
+  gst_perf_account (perf, time, GST_BUFFER_PTS (buf), 1,
+      gst_buffer_get_size (buf));
+
+  if (perf->track_push) {
+    start = gst_util_get_timestamp ();
+  }
+
+  ret = gst_pad_push (perf->srcpad, buf);
+
+  if (perf->track_push) {
+    gst_perf_account_push (perf, time, start);
   }
 
   return ret;
 }
 
+typedef struct
+{
+  GstPerf *perf;
+  GstClockTime time;
+  guint64 bytes;
+} GstPerfListData;
+
+static gboolean
+gst_perf_handle_list_buffer (GstBuffer ** buf, guint idx, gpointer user_data)
+{
+  GstPerfListData *data = user_data;
+  GstPerf *perf = data->perf;
+
+  /* Only the ingress made the list writable, it may replace the buffers */
+  if (GST_PERF_LATENCY_ROLE_INGRESS == perf->latency_running_role) {
+    *buf = gst_buffer_make_writable (*buf);
+  }
+
+  if (GST_PERF_LATENCY_ROLE_NONE != perf->latency_running_role) {
+    gst_perf_handle_latency_meta (perf, *buf, data->time);
+  }
+
+  if (perf->track_media) {
+    gst_perf_account_media (perf, *buf);
+  }
+
+  if (perf->recorder) {
+    gst_perf_record (perf, data->time, *buf);
+  }
+
+  data->bytes += gst_buffer_get_size (*buf);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_perf_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstPerf *perf = GST_PERF (parent);
+  GstPerfListData data;
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GstFlowReturn ret;
+  guint length;
+
+  data.perf = perf;
+  data.time = gst_util_get_timestamp ();
+  data.bytes = 0;
+
+  if (GST_PERF_LATENCY_ROLE_INGRESS == perf->latency_running_role) {
+    list = gst_buffer_list_make_writable (list);
+  }
+
+  gst_buffer_list_foreach (list, gst_perf_handle_list_buffer, &data);
+
+  /*
+   * The whole list arrived at once, account for it in a single update and
+   * keep the batching upstream did by pushing it unsplit.
+   */
+  length = gst_buffer_list_length (list);
+  if (length) {
+    pts = GST_BUFFER_PTS (gst_buffer_list_get (list, length - 1));
+  }
+
+  gst_perf_account (perf, data.time, pts, length, data.bytes);
+
+  if (perf->track_push) {
+    start = gst_util_get_timestamp ();
+  }
+
+  ret = gst_pad_push_list (perf->srcpad, list);
+
+  if (perf->track_push) {
+    gst_perf_account_push (perf, data.time, start);
+  }
+
+  return ret;
+}
+
+/*
+ * Splits the streaming thread time into blocked in the push that started
+ * at @start and idle between the end of the previous push and @arrival.
+ */
+static void
+gst_perf_account_push (GstPerf * perf, GstClockTime arrival,
+    GstClockTime start)
+{
+  GstClockTime end = gst_util_get_timestamp ();
+
+  if (GST_CLOCK_TIME_IS_VALID (perf->push_end) && arrival > perf->push_end) {
+    gst_perf_atomic_u64_add (&perf->idle_time, arrival - perf->push_end);
+  }
+
+  gst_perf_atomic_u64_add (&perf->blocked_time, end - start);
+  perf->push_end = end;
+}
+
+/*
+ * Accounts the running time @buf covers past the furthest point reached so
+ * far, overlaps and buffers outside of the segment add nothing.
+ */
+static void
+gst_perf_account_media (GstPerf * perf, GstBuffer * buf)
+{
+  GstClockTime start, stop;
+
+  if (GST_FORMAT_TIME != perf->segment.format) {
+    return;
+  }
+
+  start = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) :
+      GST_BUFFER_DTS (buf);
+  if (!GST_CLOCK_TIME_IS_VALID (start)) {
+    return;
+  }
+
+  stop = start;
+  if (GST_BUFFER_DURATION_IS_VALID (buf)) {
+    stop += GST_BUFFER_DURATION (buf);
+  }
+
+  start = gst_segment_to_running_time (&perf->segment, GST_FORMAT_TIME, start);
+  if (!GST_CLOCK_TIME_IS_VALID (start)) {
+    return;
+  }
+
+  /* A buffer running past the segment stop counts up to its start */
+  stop = gst_segment_to_running_time (&perf->segment, GST_FORMAT_TIME, stop);
+  if (!GST_CLOCK_TIME_IS_VALID (stop)) {
+    stop = start;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (perf->media_end)) {
+    perf->media_end = start;
+  }
+
+  if (stop > perf->media_end) {
+    gst_perf_atomic_u64_add (&perf->media_duration, stop - perf->media_end);
+    perf->media_end = stop;
+  }
+}
+
+/*
+ * Only a few stores per buffer, the thread CPU time is read just when
+ * print-thread-cpu is set. The triggers are acted upon by the timer.
+ */
+static void
+gst_perf_record (GstPerf * perf, GstClockTime time, GstBuffer * buf)
+{
+  const GstPerfRecord *previous;
+  GstPerfRecord *record;
+
+  previous = gst_perf_recorder_previous (perf->recorder);
+  if (perf->recorder_running_max_gap && previous &&
+      time > previous->arrival + perf->recorder_running_max_gap) {
+    g_atomic_int_or (&perf->recorder_trigger, GST_PERF_RECORDER_TRIGGER_GAP);
+  }
+
+  record = gst_perf_recorder_claim (perf->recorder);
+  record->arrival = time;
+  record->pts = GST_BUFFER_PTS (buf);
+  record->thread_cpu = perf->track_thread ? gst_perf_get_self_cpu_time () :
+      GST_CLOCK_TIME_NONE;
+  record->size = gst_buffer_get_size (buf);
+  record->flags = GST_BUFFER_FLAGS (buf);
+}
+
+/* Accounts @frames totalling @bytes that arrived at @time, the last at @pts */
+static void
+gst_perf_account (GstPerf * perf, GstClockTime time, GstClockTime pts,
+    guint frames, guint64 bytes)
+{
+  if (perf->stall_running_timeout || perf->shm_slot) {
+    gst_perf_seqlock_write_begin (&perf->last_buffer_seqlock);
+    perf->last_buffer.arrival = time;
+    perf->last_buffer.pts = pts;
+    gst_perf_seqlock_write_end (&perf->last_buffer_seqlock);
+  }
+
+  if (perf->gap_histogram) {
+    if (GST_CLOCK_TIME_IS_VALID (perf->last_arrival)) {
+      gst_perf_histogram_record (perf->gap_histogram,
+          GST_CLOCK_DIFF (perf->last_arrival, time));
+    }
+    perf->last_arrival = time;
+  }
+
+  if (perf->track_thread) {
+    guint thread = gst_perf_get_thread_id ();
+
+    if (thread != perf->cpu_thread) {
+      perf->cpu_thread = thread;
+      gst_perf_publish_thread (perf);
+    }
+#ifdef HAVE_SCHED_GETCPU
+    {
+      /* Served from the vDSO, cheap enough to do on every push */
+      gint core = sched_getcpu ();
+
+      if (core != perf->current_core) {
+        if (perf->current_core >= 0) {
+          gst_perf_atomic_u64_add (&perf->migrations, 1);
+        }
+        perf->current_core = core;
+        g_atomic_int_set (&perf->last_core, core);
+      }
+    }
+#endif
+  }
+
+  /* Everything else is computed by the timer */
+  gst_perf_atomic_u64_add (&perf->frame_count, frames);
+  gst_perf_atomic_u64_add (&perf->byte_count, bytes);
+}
+
+static void
+gst_perf_structure_set_ewma (GstStructure * structure, const gchar * prefix,
+    const GstPerfEwma * ewma)
+{
+  gchar field[GST_PERF_FIELD_MAX_SIZE];
+  guint i;
+
+  for (i = 0; i < GST_PERF_EWMA_HORIZONS; i++) {
+    g_snprintf (field, sizeof (field), "%s_%s", prefix,
+        gst_perf_ewma_horizon_name (i));
+    gst_structure_set (structure, field, G_TYPE_DOUBLE, ewma->average[i],
+        NULL);
+  }
+}
+
+static void
+gst_perf_format_ewma (GString * info, const gchar * prefix,
+    const GstPerfEwma * ewma)
+{
+  guint i;
+
+  for (i = 0; i < GST_PERF_EWMA_HORIZONS; i++) {
+    g_string_append_printf (info, "; %s_%s: %0.03f", prefix,
+        gst_perf_ewma_horizon_name (i), ewma->average[i]);
+  }
+}
+
+static void
+gst_perf_format_histogram (GString * info, const gchar * prefix,
+    const GstPerfHistogramStats * stats)
+{
+  g_string_append_printf (info, "; %s_min: %0.03f; %s_p50: %0.03f; "
+      "%s_p90: %0.03f; %s_p99: %0.03f; %s_p999: %0.03f; %s_max: %0.03f; "
+      "%s_stddev: %0.03f",
+      prefix, 1.0 * stats->min / GST_MSECOND,
+      prefix, 1.0 * stats->p50 / GST_MSECOND,
+      prefix, 1.0 * stats->p90 / GST_MSECOND,
+      prefix, 1.0 * stats->p99 / GST_MSECOND,
+      prefix, 1.0 * stats->p999 / GST_MSECOND,
+      prefix, 1.0 * stats->max / GST_MSECOND,
+      prefix, stats->stddev / GST_MSECOND);
+}
+
+static GstStructure *
+gst_perf_report_to_structure (const GstPerfReport * report)
+{
+  GstStructure *structure;
+
+  g_return_val_if_fail (report, NULL);
+
+  structure = gst_structure_new ("perf",
+      "timestamp", G_TYPE_UINT64, report->timestamp,
+      "bps", G_TYPE_DOUBLE, report->bps,
+      "mean_bps", G_TYPE_DOUBLE, report->mean_bps,
+      "fps", G_TYPE_DOUBLE, report->fps,
+      "mean_fps", G_TYPE_DOUBLE, report->mean_fps, NULL);
+
+  if (report->has_cpu_load) {
+    gst_structure_set (structure, "cpu", G_TYPE_INT, report->cpu_load, NULL);
+  }
+
+  if (report->has_horizons) {
+    gst_perf_structure_set_ewma (structure, "fps", &report->fps_horizons);
+    gst_perf_structure_set_ewma (structure, "bps", &report->bps_horizons);
+
+    if (report->has_cpu_load) {
+      gst_perf_structure_set_ewma (structure, "cpu", &report->cpu_horizons);
+      gst_structure_set (structure, "mean_cpu", G_TYPE_DOUBLE,
+          report->mean_cpu, NULL);
+    }
+  }
+
+  if (report->has_media_time) {
+    gst_structure_set (structure,
+        "media_time", G_TYPE_UINT64, report->media_time,
+        "media_fps", G_TYPE_DOUBLE, report->media_fps,
+        "media_bps", G_TYPE_DOUBLE, report->media_bps,
+        "realtime_factor", G_TYPE_DOUBLE, report->realtime_factor, NULL);
+  }
+
+  if (report->has_nominal_fps) {
+    gst_structure_set (structure,
+        "nominal_fps", G_TYPE_DOUBLE, report->nominal_fps,
+        "dropped_fps", G_TYPE_DOUBLE, report->dropped_fps, NULL);
+  }
+
+  if (report->has_pixels) {
+    gst_structure_set (structure, "mpixels_per_second", G_TYPE_DOUBLE,
+        report->mpixels_per_second, NULL);
+  }
+
+  if (report->has_samples) {
+    gst_structure_set (structure, "samples_per_second", G_TYPE_DOUBLE,
+        report->samples_per_second, NULL);
+  }
+
+  if (report->has_compression) {
+    gst_structure_set (structure,
+        "bits_per_pixel", G_TYPE_DOUBLE, report->bits_per_pixel,
+        "compression_ratio", G_TYPE_DOUBLE, report->compression_ratio, NULL);
+  }
+
+  if (report->has_backpressure) {
+    gst_structure_set (structure,
+        "blocked_time", G_TYPE_UINT64, report->blocked_time,
+        "idle_time", G_TYPE_UINT64, report->idle_time,
+        "backpressure", G_TYPE_DOUBLE, report->backpressure, NULL);
+  }
+
+  if (report->has_jitter) {
+    gst_perf_histogram_stats_set_structure (structure, "gap", &report->gap);
+    gst_perf_histogram_stats_set_structure (structure, "run_gap",
+        &report->run_gap);
+  }
+
+  if (report->has_latency) {
+    gst_perf_histogram_stats_set_structure (structure, "latency",
+        &report->latency);
+    gst_perf_histogram_stats_set_structure (structure, "run_latency",
+        &report->run_latency);
+  }
+
+  if (report->has_thread_cpu) {
+    gst_structure_set (structure,
+        "thread_cpu", G_TYPE_DOUBLE, report->thread_cpu,
+        "process_cpu", G_TYPE_DOUBLE, report->process_cpu,
+        "thread_cpu_time", G_TYPE_UINT64, report->thread_cpu_time,
+        "process_cpu_time", G_TYPE_UINT64, report->process_cpu_time, NULL);
+  }
+
+  if (report->has_core) {
+    gst_structure_set (structure,
+        "core", G_TYPE_INT, report->core,
+        "migrations", G_TYPE_UINT, report->migrations, NULL);
+  }
+
+  if (report->n_cores) {
+    GValue cores = G_VALUE_INIT;
+    GValue load = G_VALUE_INIT;
+    guint i;
+
+    g_value_init (&cores, GST_TYPE_ARRAY);
+    g_value_init (&load, G_TYPE_INT);
+    for (i = 0; i < report->n_cores; i++) {
+      g_value_set_int (&load, report->core_load[i]);
+      gst_value_array_append_value (&cores, &load);
+    }
+    gst_structure_take_value (structure, "core_load", &cores);
+    g_value_unset (&load);
+  }
+
+  if (report->has_memory) {
+    gst_structure_set (structure,
+        "rss", G_TYPE_UINT64, report->rss,
+        "mem_total", G_TYPE_UINT64, report->mem_total,
+        "mem_available", G_TYPE_UINT64, report->mem_available, NULL);
+  }
+
+  return structure;
+}
+
+static void
+gst_perf_post_report (GstPerf * perf, const GstPerfReport * report)
+{
+  GstPerfMessageFormat message_format;
+
+  g_return_if_fail (perf);
+  g_return_if_fail (report);
+
+  GST_OBJECT_LOCK (perf);
+  message_format = perf->message_format;
+  GST_OBJECT_UNLOCK (perf);
+
+  if (GST_PERF_MESSAGE_FORMAT_ELEMENT == message_format) {
+    GstStructure *structure = gst_perf_report_to_structure (report);
+
+    /* Only formatted if the debug level is enabled */
+    GST_INFO_OBJECT (perf, "%" GST_PTR_FORMAT, structure);
+
+    gst_element_post_message ((GstElement *) perf,
+        gst_message_new_element ((GstObject *) perf, structure));
+  } else {
+    GString *info = g_string_sized_new (GST_PERF_MSG_SIZE);
+
+    g_string_append_printf (info, "perf: %s; timestamp: %" GST_TIME_FORMAT "; "
+        "bps: %0.03f; mean_bps: %0.03f; " "fps: %0.03f; mean_fps: %0.03f",
+        GST_OBJECT_NAME (perf), GST_TIME_ARGS (report->timestamp),
+        report->bps, report->mean_bps, report->fps, report->mean_fps);
+
+    if (report->has_horizons) {
+      gst_perf_format_ewma (info, "fps", &report->fps_horizons);
+      gst_perf_format_ewma (info, "bps", &report->bps_horizons);
+
+      if (report->has_cpu_load) {
+        gst_perf_format_ewma (info, "cpu", &report->cpu_horizons);
+        g_string_append_printf (info, "; mean_cpu: %0.03f", report->mean_cpu);
+      }
+    }
+
+    if (report->has_media_time) {
+      g_string_append_printf (info,
+          "; media_fps: %0.03f; media_bps: %0.03f; realtime_factor: %0.03f",
+          report->media_fps, report->media_bps, report->realtime_factor);
+    }
+
+    if (report->has_nominal_fps) {
+      g_string_append_printf (info,
+          "; nominal_fps: %0.03f; dropped_fps: %0.03f",
+          report->nominal_fps, report->dropped_fps);
+    }
+
+    if (report->has_pixels) {
+      g_string_append_printf (info,
+          "; mpixels_per_second: %0.03f", report->mpixels_per_second);
+    }
+
+    if (report->has_samples) {
+      g_string_append_printf (info,
+          "; samples_per_second: %0.03f", report->samples_per_second);
+    }
+
+    if (report->has_compression) {
+      g_string_append_printf (info,
+          "; bits_per_pixel: %0.03f; compression_ratio: %0.03f",
+          report->bits_per_pixel, report->compression_ratio);
+    }
+
+    if (report->has_backpressure) {
+      g_string_append_printf (info,
+          "; blocked_time: %0.03f; idle_time: %0.03f; backpressure: %0.03f",
+          1.0 * report->blocked_time / GST_MSECOND,
+          1.0 * report->idle_time / GST_MSECOND, report->backpressure);
+    }
+
+    if (report->has_jitter) {
+      gst_perf_format_histogram (info, "gap", &report->gap);
+      gst_perf_format_histogram (info, "run_gap", &report->run_gap);
+    }
+
+    if (report->has_latency) {
+      gst_perf_format_histogram (info, "latency", &report->latency);
+      gst_perf_format_histogram (info, "run_latency", &report->run_latency);
+    }
+
+    if (report->has_thread_cpu) {
+      g_string_append_printf (info, "; thread_cpu: %0.03f; process_cpu: %0.03f",
+          report->thread_cpu, report->process_cpu);
+    }
+
+    if (report->has_core) {
+      g_string_append_printf (info,
+          "; core: %d; migrations: %u", report->core, report->migrations);
+    }
+
+    if (report->has_memory) {
+      g_string_append_printf (info,
+          "; rss: %" G_GUINT64_FORMAT "; mem_total: %" G_GUINT64_FORMAT
+          "; mem_available: %" G_GUINT64_FORMAT, report->rss,
+          report->mem_total, report->mem_available);
+    }
+
+    if (report->has_cpu_load) {
+      g_string_append_printf (info, "; cpu: %d; ", report->cpu_load);
+    }
+
+    if (report->n_cores) {
+      guint i;
+
+      g_string_append_printf (info, "core_load: %d", report->core_load[0]);
+      for (i = 1; i < report->n_cores; i++) {
+        g_string_append_printf (info, ",%d", report->core_load[i]);
+      }
+    }
+
+    gst_element_post_message (
+        (GstElement *) perf,
+        gst_message_new_info ((GstObject *) perf, perf->error,
+            info->str));
+
+    GST_INFO_OBJECT (perf, "%s", info->str);
+    g_string_free (info, TRUE);
+  }
+}
+
+static void
+gst_perf_publish_stats (GstPerf * perf, const GstPerfReport * report)
+{
+  g_return_if_fail (perf);
+  g_return_if_fail (report);
+
+  gst_perf_seqlock_write_begin (&perf->stats_seqlock);
+  perf->stats = *report;
+  /* The core loads belong to the sample, which is gone after the report */
+  perf->stats.n_cores = 0;
+  perf->stats.core_load = NULL;
+  gst_perf_seqlock_write_end (&perf->stats_seqlock);
+}
+
+/* Readers in other processes follow the same seqlock as the stats */
+static void
+gst_perf_publish_shm (GstPerf * perf, const GstPerfReport * report)
+{
+  GstPerfShmSlot *slot = perf->shm_slot;
+  GstPerfLastBuffer last;
+  guint32 fields = 0;
+  guint sequence;
+
+  g_return_if_fail (slot);
+  g_return_if_fail (report);
+
+  do {
+    sequence = gst_perf_seqlock_read_begin (&perf->last_buffer_seqlock);
+    last = perf->last_buffer;
+  } while (gst_perf_seqlock_read_retry (&perf->last_buffer_seqlock, sequence));
+
+  gst_perf_seqlock_write_begin (&slot->sequence);
+
+  slot->reports++;
+  slot->timestamp = report->timestamp;
+  slot->fps = report->fps;
+  slot->mean_fps = report->mean_fps;
+  slot->bps = report->bps;
+  slot->mean_bps = report->mean_bps;
+
+  if (report->has_cpu_load && report->cpu_load >= 0) {
+    fields |= GST_PERF_SHM_HAS_CPU_LOAD;
+    slot->cpu_load = report->cpu_load;
+  }
+
+  if (report->has_thread_cpu) {
+    fields |= GST_PERF_SHM_HAS_THREAD_CPU;
+    slot->thread_cpu = report->thread_cpu;
+    slot->process_cpu = report->process_cpu;
+  }
+
+  if (report->has_jitter) {
+    fields |= GST_PERF_SHM_HAS_GAP;
+    slot->gap_p50 = report->gap.p50;
+    slot->gap_p99 = report->gap.p99;
+  }
+
+  if (report->has_latency) {
+    fields |= GST_PERF_SHM_HAS_LATENCY;
+    slot->latency_p50 = report->latency.p50;
+    slot->latency_p99 = report->latency.p99;
+  }
+
+  if (report->has_backpressure) {
+    fields |= GST_PERF_SHM_HAS_BACKPRESSURE;
+    slot->backpressure = report->backpressure;
+  }
+
+  if (report->has_media_time) {
+    fields |= GST_PERF_SHM_HAS_MEDIA_TIME;
+    slot->realtime_factor = report->realtime_factor;
+  }
+
+  /* Lets readers tell a stalled stream from one that is slow */
+  if (GST_CLOCK_TIME_IS_VALID (last.arrival)) {
+    fields |= GST_PERF_SHM_HAS_LAST_BUFFER;
+    slot->last_arrival = last.arrival;
+  }
+  slot->stall_timeout = perf->stall_running_timeout;
+
+  slot->fields = fields;
+
+  gst_perf_seqlock_write_end (&slot->sequence);
+}
+
+static GstStructure *
+gst_perf_get_stats (GstPerf * perf)
+{
+  GstPerfReport stats;
+  guint sequence;
+
+  g_return_val_if_fail (perf, NULL);
+
+  /* Never blocks the streaming thread, retry if it wrote meanwhile */
+  do {
+    sequence = gst_perf_seqlock_read_begin (&perf->stats_seqlock);
+    stats = perf->stats;
+  } while (gst_perf_seqlock_read_retry (&perf->stats_seqlock, sequence));
+
+  return gst_perf_report_to_structure (&stats);
+}
+
 static void
 gst_perf_reset (GstPerf * perf)
 {
   g_return_if_fail (perf);
 
-  perf->frame_count = 0;
+  gst_perf_atomic_u64_set (&perf->frame_count, G_GUINT64_CONSTANT (0));
 }
 
 static void
@@ -640,16 +2566,57 @@ gst_perf_clear (GstPerf * perf)
 
   gst_perf_reset (perf);
 
+  gst_perf_seqlock_write_begin (&perf->stats_seqlock);
+  memset (&perf->stats, 0, sizeof (perf->stats));
+  gst_perf_seqlock_write_end (&perf->stats_seqlock);
+
   perf->fps = 0.0;
   perf->frame_count_total = G_GUINT64_CONSTANT (0);
 
   perf->mean_bps = 0.0;
   perf->byte_count_total = G_GUINT64_CONSTANT (0);
-  perf->byte_count = G_GUINT64_CONSTANT (0);
-
-  perf->prev_timestamp = GST_CLOCK_TIME_NONE;
-  perf->prev_cpu_total = 0;
-  perf->prev_cpu_idle = 0;
+  gst_perf_atomic_u64_set (&perf->byte_count, G_GUINT64_CONSTANT (0));
+
+  perf->last_arrival = GST_CLOCK_TIME_NONE;
+  perf->cpu_thread = 0;
+  perf->prev_thread_cpu_time = GST_CLOCK_TIME_NONE;
+  perf->prev_process_cpu_time = GST_CLOCK_TIME_NONE;
+  perf->current_core = -1;
+  g_atomic_int_set (&perf->last_core, -1);
+
+  gst_perf_seqlock_write_begin (&perf->last_buffer_seqlock);
+  perf->last_buffer.arrival = GST_CLOCK_TIME_NONE;
+  perf->last_buffer.pts = GST_CLOCK_TIME_NONE;
+  gst_perf_seqlock_write_end (&perf->last_buffer_seqlock);
+  perf->stall_arrival = GST_CLOCK_TIME_NONE;
+
+  gst_segment_init (&perf->segment, GST_FORMAT_UNDEFINED);
+  perf->media_end = GST_CLOCK_TIME_NONE;
+  gst_perf_atomic_u64_set (&perf->media_duration, G_GUINT64_CONSTANT (0));
+
+  perf->push_end = GST_CLOCK_TIME_NONE;
+
+  g_atomic_int_set (&perf->recorder_trigger, 0);
+  perf->recorder_below = FALSE;
+  gst_perf_atomic_u64_set (&perf->blocked_time, G_GUINT64_CONSTANT (0));
+  gst_perf_atomic_u64_set (&perf->idle_time, G_GUINT64_CONSTANT (0));
+
+  GST_OBJECT_LOCK (perf);
+  perf->caps_fps_n = 0;
+  perf->caps_fps_d = 1;
+  perf->caps_pixels = G_GUINT64_CONSTANT (0);
+  perf->caps_bpf = 0;
+  perf->caps_raw_pixels = G_GUINT64_CONSTANT (0);
+  perf->caps_raw_size = G_GUINT64_CONSTANT (0);
+  GST_OBJECT_UNLOCK (perf);
+  gst_perf_atomic_u64_set (&perf->migrations, G_GUINT64_CONSTANT (0));
+
+  gst_perf_ewma_reset (&perf->fps_horizons);
+  gst_perf_ewma_reset (&perf->bps_horizons);
+  gst_perf_ewma_reset (&perf->cpu_horizons);
+  perf->mean_cpu = 0.0;
+  perf->cpu_count = G_GUINT64_CONSTANT (0);
+  perf->cpu_timestamp = GST_CLOCK_TIME_NONE;
 }
 
 static gboolean
@@ -659,6 +2626,17 @@ plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (gst_perf_debug, "perf", 0,
       "Debug category for perf element");
 
+#if GST_CHECK_VERSION(1,8,0)
+  if (!gst_tracer_register (plugin, "perftracer", GST_TYPE_PERF_TRACER)) {
+    return FALSE;
+  }
+#endif
+
+  if (!gst_element_register (plugin, "perfbin", GST_RANK_NONE,
+          GST_TYPE_PERF_BIN)) {
+    return FALSE;
+  }
+
   return gst_element_register (plugin, "perf", GST_RANK_NONE, GST_TYPE_PERF);
 }
 
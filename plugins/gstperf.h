@@ -21,7 +21,6 @@
 #define _GST_PERF_H_
 
 #include <gst/gst.h>
-#include <gst/base/gstbasetransform.h>
 
 G_BEGIN_DECLS
 #define GST_TYPE_PERF \
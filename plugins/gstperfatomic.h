@@ -0,0 +1,97 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_ATOMIC_H_
+#define _GST_PERF_ATOMIC_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * GLib only provides 32-bit and pointer sized atomics, which would make
+ * 64-bit counters wrap on 32-bit targets. These helpers use the compiler
+ * builtins directly.
+ */
+static inline void
+gst_perf_atomic_u64_add (guint64 * atomic, guint64 val)
+{
+  __atomic_fetch_add (atomic, val, __ATOMIC_RELAXED);
+}
+
+static inline guint64
+gst_perf_atomic_u64_get (guint64 * atomic)
+{
+  return __atomic_load_n (atomic, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+gst_perf_atomic_u64_set (guint64 * atomic, guint64 val)
+{
+  __atomic_store_n (atomic, val, __ATOMIC_RELEASE);
+}
+
+/* Returns the current value and replaces it with @val */
+static inline guint64
+gst_perf_atomic_u64_exchange (guint64 * atomic, guint64 val)
+{
+  return __atomic_exchange_n (atomic, val, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * Sequence lock for a single writer and any number of readers. The writer
+ * never waits and readers never block it, they retry if a write happened
+ * while they were copying. The writer must be a single thread.
+ */
+static inline void
+gst_perf_seqlock_write_begin (guint * seqlock)
+{
+  __atomic_store_n (seqlock, *seqlock + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+static inline void
+gst_perf_seqlock_write_end (guint * seqlock)
+{
+  __atomic_store_n (seqlock, *seqlock + 1, __ATOMIC_RELEASE);
+}
+
+/* Returns the sequence to hand to gst_perf_seqlock_read_retry() */
+static inline guint
+gst_perf_seqlock_read_begin (const guint * seqlock)
+{
+  guint sequence;
+
+  /* An odd sequence means a write is in progress */
+  while ((sequence = __atomic_load_n (seqlock, __ATOMIC_ACQUIRE)) & 1) {
+  }
+
+  return sequence;
+}
+
+/* Returns TRUE if the data read since @sequence may be torn */
+static inline gboolean
+gst_perf_seqlock_read_retry (const guint * seqlock, guint sequence)
+{
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  return __atomic_load_n (seqlock, __ATOMIC_RELAXED) != sequence;
+}
+
+G_END_DECLS
+#endif
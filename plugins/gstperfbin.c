@@ -0,0 +1,790 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:element-perfbin
+ *
+ * perfbin wraps a single element and measures it from the outside:
+ *
+ * |[
+ * gst-launch-1.0 videotestsrc ! perfbin element=x264enc ! fakesink
+ * ]|
+ *
+ * Probes on the sink and src pads of the child count what goes in and
+ * comes out, and match every output buffer with the input buffer of the
+ * same PTS, or of the same offset when there is no PTS, to get the
+ * processing latency of the child. Buffers a child drops, merges or
+ * splits simply don't match.
+ *
+ * Every interval a GST_MESSAGE_ELEMENT is posted with a "perfbin"
+ * structure holding the input and output fps and bitrate, the latency
+ * distribution of the interval and of the whole run, the number of
+ * buffers inside the child and the CPU load of the threads seen pushing
+ * into or out of the child.
+ *
+ * The child is created from its factory name when the element property is
+ * set, which is only possible in the NULL and READY states. Only children
+ * with "sink" and "src" always pads are supported.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfbin.h"
+#include "gstperfatomic.h"
+#include "gstperfhistogram.h"
+#include "gstperfutils.h"
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+#  include <pthread.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (gst_perf_bin_debug);
+#define GST_CAT_DEFAULT gst_perf_bin_debug
+
+#define DEFAULT_ELEMENT NULL
+#define DEFAULT_INTERVAL 1000
+
+/* Enough for the lookahead of common encoders */
+#define GST_PERF_BIN_MAX_PENDING 256
+
+#define GST_PERF_BIN_BITS_PER_BYTE 8
+
+/* Whatever the child accepts, the caps queries reach it through the pads */
+static GstStaticPadTemplate gst_perf_bin_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_perf_bin_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+enum
+{
+  PROP_0,
+  PROP_ELEMENT,
+  PROP_INTERVAL
+};
+
+/* An input buffer waiting for its output, consumed once arrival is NONE */
+typedef struct _GstPerfBinPending
+{
+  GstClockTime pts;
+  guint64 offset;
+  GstClockTime arrival;
+} GstPerfBinPending;
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+typedef struct _GstPerfBinThread
+{
+  guint id;
+  clockid_t clock;
+  GstClockTime cpu_time;
+} GstPerfBinThread;
+#endif
+
+struct _GstPerfBin
+{
+  GstBin parent;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  /* The wrapped element and the probes on its pads */
+  GstElement *child;
+  GstPad *child_sinkpad;
+  GstPad *child_srcpad;
+  gulong sink_probe;
+  gulong src_probe;
+
+  /* Accumulated by the probes, drained atomically by the timer */
+  guint64 in_frames;
+  guint64 in_bytes;
+  guint64 out_frames;
+  guint64 out_bytes;
+
+  /*
+   * Ring of the buffers inside the child, protected by pending_lock. The
+   * entries waiting for an output are indexed by PTS, or by offset when
+   * they have no PTS, the keys point into the ring.
+   */
+  GMutex pending_lock;
+  GstPerfBinPending pending[GST_PERF_BIN_MAX_PENDING];
+  guint pending_head;
+  guint pending_length;
+  GHashTable *pending_by_pts;
+  GHashTable *pending_by_offset;
+
+  GstPerfHistogram *latency_histogram;
+  GstPerfHistogram *latency_snapshot;
+  GstPerfHistogram *latency_reported;
+
+  /*
+   * Threads seen on either side, protected by thread_lock. The last
+   * thread of each side is owned by the probe of that side.
+   */
+  GMutex thread_lock;
+  GArray *threads;
+  guint sink_thread;
+  guint src_thread;
+
+  GstPerfTicker *ticker;
+
+  /* Properties */
+  gchar *element;
+  guint interval;
+};
+
+struct _GstPerfBinClass
+{
+  GstBinClass parent_class;
+};
+
+#define gst_perf_bin_parent_class parent_class
+G_DEFINE_TYPE (GstPerfBin, gst_perf_bin, GST_TYPE_BIN);
+
+static void gst_perf_bin_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_perf_bin_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_perf_bin_dispose (GObject * object);
+static void gst_perf_bin_finalize (GObject * object);
+
+static GstStateChangeReturn gst_perf_bin_change_state (GstElement * element,
+    GstStateChange transition);
+static void gst_perf_bin_set_child (GstPerfBin * self, const gchar * name);
+static void gst_perf_bin_tick (gpointer data, GstClockTime elapsed);
+
+static void
+gst_perf_bin_class_init (GstPerfBinClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->set_property = gst_perf_bin_set_property;
+  gobject_class->get_property = gst_perf_bin_get_property;
+  gobject_class->dispose = gst_perf_bin_dispose;
+  gobject_class->finalize = gst_perf_bin_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_ELEMENT,
+      g_param_spec_string ("element", "Element",
+          "Factory name of the element to wrap and measure, can only be "
+          "set in the NULL and READY states", DEFAULT_ELEMENT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint ("interval", "Interval between reports in ms",
+          "Interval between two reports in ms, 0 uses the default", 0,
+          G_MAXINT, DEFAULT_INTERVAL, G_PARAM_READWRITE));
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_perf_bin_change_state);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_perf_bin_src_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_perf_bin_sink_template));
+
+  gst_element_class_set_static_metadata (element_class,
+      "Performance bin", "Generic/Bin",
+      "Measure the latency, throughput and CPU load of an element",
+      "Melissa Montero <melissa.montero@ridgerun.com>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_perf_bin_debug, "perfbin", 0,
+      "Debug category for perfbin element");
+}
+
+static void
+gst_perf_bin_init (GstPerfBin * self)
+{
+  GstElementClass *element_class = GST_ELEMENT_GET_CLASS (self);
+
+  self->element = DEFAULT_ELEMENT;
+  self->interval = DEFAULT_INTERVAL;
+
+  g_mutex_init (&self->pending_lock);
+  self->pending_by_pts = g_hash_table_new (g_int64_hash, g_int64_equal);
+  self->pending_by_offset = g_hash_table_new (g_int64_hash, g_int64_equal);
+  g_mutex_init (&self->thread_lock);
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  self->threads = g_array_new (FALSE, FALSE, sizeof (GstPerfBinThread));
+#endif
+
+  /* Targeted at the child pads once there is a child */
+  self->sinkpad = gst_ghost_pad_new_no_target_from_template ("sink",
+      gst_element_class_get_pad_template (element_class, "sink"));
+  gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+  self->srcpad = gst_ghost_pad_new_no_target_from_template ("src",
+      gst_element_class_get_pad_template (element_class, "src"));
+  gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+}
+
+static void
+gst_perf_bin_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstPerfBin *self = GST_PERF_BIN (object);
+
+  switch (property_id) {
+    case PROP_ELEMENT:
+      /* The probes and the ghost pads can't change while streaming */
+      if (GST_STATE (self) > GST_STATE_READY) {
+        GST_WARNING_OBJECT (self, "Can't change the element while running");
+        break;
+      }
+      GST_OBJECT_LOCK (self);
+      g_free (self->element);
+      self->element = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      gst_perf_bin_set_child (self, g_value_get_string (value));
+      break;
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      self->interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_perf_bin_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstPerfBin *self = GST_PERF_BIN (object);
+
+  switch (property_id) {
+    case PROP_ELEMENT:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->element);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->interval);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_perf_bin_dispose (GObject * object)
+{
+  GstPerfBin *self = GST_PERF_BIN (object);
+
+  gst_perf_bin_set_child (self, NULL);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gst_perf_bin_finalize (GObject * object)
+{
+  GstPerfBin *self = GST_PERF_BIN (object);
+
+  if (self->threads) {
+    g_array_free (self->threads, TRUE);
+  }
+  g_mutex_clear (&self->thread_lock);
+  g_hash_table_unref (self->pending_by_pts);
+  g_hash_table_unref (self->pending_by_offset);
+  g_mutex_clear (&self->pending_lock);
+  g_free (self->element);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Called by the probe of one side when the thread is not the one before */
+static void
+gst_perf_bin_see_thread (GstPerfBin * self, guint * last)
+{
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  guint id = gst_perf_get_thread_id ();
+  GstPerfBinThread entry;
+  guint i;
+
+  if (G_LIKELY (id == *last)) {
+    return;
+  }
+  *last = id;
+
+  g_mutex_lock (&self->thread_lock);
+  for (i = 0; i < self->threads->len; i++) {
+    if (g_array_index (self->threads, GstPerfBinThread, i).id == id) {
+      break;
+    }
+  }
+
+  if (i == self->threads->len &&
+      0 == pthread_getcpuclockid (pthread_self (), &entry.clock)) {
+    entry.id = id;
+    entry.cpu_time = gst_perf_get_thread_cpu_time (entry.clock);
+    g_array_append_val (self->threads, entry);
+  }
+  g_mutex_unlock (&self->thread_lock);
+#endif
+}
+
+/* Returns the index @entry belongs to, NULL if it can't be matched */
+static GHashTable *
+gst_perf_bin_pending_index (GstPerfBin * self, GstPerfBinPending * entry,
+    guint64 ** key)
+{
+  if (GST_CLOCK_TIME_IS_VALID (entry->pts)) {
+    *key = &entry->pts;
+    return self->pending_by_pts;
+  }
+
+  if (GST_BUFFER_OFFSET_NONE != entry->offset) {
+    *key = &entry->offset;
+    return self->pending_by_offset;
+  }
+
+  return NULL;
+}
+
+/* Takes @entry out of its index, unless a later input replaced it there */
+static void
+gst_perf_bin_unindex_pending (GstPerfBin * self, GstPerfBinPending * entry)
+{
+  GHashTable *index;
+  guint64 *key;
+
+  index = gst_perf_bin_pending_index (self, entry, &key);
+  if (index && entry == g_hash_table_lookup (index, key)) {
+    g_hash_table_remove (index, key);
+  }
+}
+
+static void
+gst_perf_bin_add_pending (GstPerfBin * self, GstBuffer * buf,
+    GstClockTime time)
+{
+  GstPerfBinPending *entry;
+  GHashTable *index;
+  guint64 *key;
+
+  g_mutex_lock (&self->pending_lock);
+
+  /* The oldest buffer will never come out, forget it */
+  if (GST_PERF_BIN_MAX_PENDING == self->pending_length) {
+    entry = &self->pending[self->pending_head];
+    if (GST_CLOCK_TIME_IS_VALID (entry->arrival)) {
+      gst_perf_bin_unindex_pending (self, entry);
+    }
+    self->pending_head = (self->pending_head + 1) % GST_PERF_BIN_MAX_PENDING;
+    self->pending_length--;
+  }
+
+  entry = &self->pending[(self->pending_head + self->pending_length) %
+      GST_PERF_BIN_MAX_PENDING];
+  entry->pts = GST_BUFFER_PTS (buf);
+  entry->offset = GST_BUFFER_OFFSET (buf);
+  entry->arrival = time;
+  self->pending_length++;
+
+  /* Replacing moves the key too, it must point into the newest entry */
+  index = gst_perf_bin_pending_index (self, entry, &key);
+  if (index) {
+    g_hash_table_replace (index, key, entry);
+  }
+
+  g_mutex_unlock (&self->pending_lock);
+}
+
+/* Looks for the input of @buf, outputs may be reordered by the child */
+static void
+gst_perf_bin_match_pending (GstPerfBin * self, GstBuffer * buf,
+    GstClockTime time)
+{
+  GstPerfBinPending *entry = NULL;
+  guint64 pts = GST_BUFFER_PTS (buf);
+  guint64 offset = GST_BUFFER_OFFSET (buf);
+
+  g_mutex_lock (&self->pending_lock);
+
+  if (GST_CLOCK_TIME_IS_VALID (pts)) {
+    entry = g_hash_table_lookup (self->pending_by_pts, &pts);
+  } else if (GST_BUFFER_OFFSET_NONE != offset) {
+    entry = g_hash_table_lookup (self->pending_by_offset, &offset);
+  }
+
+  if (entry) {
+    if (time >= entry->arrival) {
+      gst_perf_histogram_record (self->latency_histogram,
+          time - entry->arrival);
+    }
+    gst_perf_bin_unindex_pending (self, entry);
+    entry->arrival = GST_CLOCK_TIME_NONE;
+  }
+
+  /* Drop the consumed entries at the head */
+  while (self->pending_length &&
+      !GST_CLOCK_TIME_IS_VALID (self->pending[self->pending_head].arrival)) {
+    self->pending_head = (self->pending_head + 1) % GST_PERF_BIN_MAX_PENDING;
+    self->pending_length--;
+  }
+
+  g_mutex_unlock (&self->pending_lock);
+}
+
+typedef struct
+{
+  GstPerfBin *self;
+  GstClockTime time;
+  gboolean input;
+  guint64 bytes;
+} GstPerfBinProbeData;
+
+static gboolean
+gst_perf_bin_handle_buffer (GstBuffer ** buf, guint idx, gpointer user_data)
+{
+  GstPerfBinProbeData *data = user_data;
+
+  if (data->input) {
+    gst_perf_bin_add_pending (data->self, *buf, data->time);
+  } else {
+    gst_perf_bin_match_pending (data->self, *buf, data->time);
+  }
+
+  data->bytes += gst_buffer_get_size (*buf);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+gst_perf_bin_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstPerfBin *self = GST_PERF_BIN (user_data);
+  GstPerfBinProbeData data;
+  guint64 frames;
+
+  data.self = self;
+  data.time = gst_util_get_timestamp ();
+  data.input = GST_PAD_SINK == GST_PAD_DIRECTION (pad);
+  data.bytes = 0;
+
+  gst_perf_bin_see_thread (self,
+      data.input ? &self->sink_thread : &self->src_thread);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    gst_buffer_list_foreach (list, gst_perf_bin_handle_buffer, &data);
+    frames = gst_buffer_list_length (list);
+  } else {
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    gst_perf_bin_handle_buffer (&buf, 0, &data);
+    frames = 1;
+  }
+
+  if (data.input) {
+    gst_perf_atomic_u64_add (&self->in_frames, frames);
+    gst_perf_atomic_u64_add (&self->in_bytes, data.bytes);
+  } else {
+    gst_perf_atomic_u64_add (&self->out_frames, frames);
+    gst_perf_atomic_u64_add (&self->out_bytes, data.bytes);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Replaces the child with a new element from factory @name, if any */
+static void
+gst_perf_bin_set_child (GstPerfBin * self, const gchar * name)
+{
+  GstElement *child;
+
+  if (self->child) {
+    gst_pad_remove_probe (self->child_sinkpad, self->sink_probe);
+    gst_pad_remove_probe (self->child_srcpad, self->src_probe);
+    gst_ghost_pad_set_target (GST_GHOST_PAD (self->sinkpad), NULL);
+    gst_ghost_pad_set_target (GST_GHOST_PAD (self->srcpad), NULL);
+    gst_object_unref (self->child_sinkpad);
+    gst_object_unref (self->child_srcpad);
+    gst_bin_remove (GST_BIN (self), self->child);
+    self->child_sinkpad = NULL;
+    self->child_srcpad = NULL;
+    self->child = NULL;
+  }
+
+  if (NULL == name) {
+    return;
+  }
+
+  child = gst_element_factory_make (name, NULL);
+  if (NULL == child) {
+    GST_WARNING_OBJECT (self, "Unable to create a %s element", name);
+    return;
+  }
+
+  gst_bin_add (GST_BIN (self), child);
+
+  self->child_sinkpad = gst_element_get_static_pad (child, "sink");
+  self->child_srcpad = gst_element_get_static_pad (child, "src");
+  if (NULL == self->child_sinkpad || NULL == self->child_srcpad) {
+    GST_WARNING_OBJECT (self, "%s has no sink and src always pads", name);
+    if (self->child_sinkpad) {
+      gst_object_unref (self->child_sinkpad);
+      self->child_sinkpad = NULL;
+    }
+    if (self->child_srcpad) {
+      gst_object_unref (self->child_srcpad);
+      self->child_srcpad = NULL;
+    }
+    gst_bin_remove (GST_BIN (self), child);
+    return;
+  }
+
+  self->child = child;
+  gst_ghost_pad_set_target (GST_GHOST_PAD (self->sinkpad),
+      self->child_sinkpad);
+  gst_ghost_pad_set_target (GST_GHOST_PAD (self->srcpad), self->child_srcpad);
+
+  self->sink_probe = gst_pad_add_probe (self->child_sinkpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      gst_perf_bin_probe, self, NULL);
+  self->src_probe = gst_pad_add_probe (self->child_srcpad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      gst_perf_bin_probe, self, NULL);
+}
+
+/* Sums the CPU time the known threads used since the previous tick */
+static gboolean
+gst_perf_bin_sample_threads (GstPerfBin * self, GstClockTime * cpu_time,
+    guint * n_threads)
+{
+  gboolean ret = FALSE;
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  guint i;
+
+  *cpu_time = 0;
+
+  g_mutex_lock (&self->thread_lock);
+  for (i = 0; i < self->threads->len;) {
+    GstPerfBinThread *entry =
+        &g_array_index (self->threads, GstPerfBinThread, i);
+    GstClockTime now = gst_perf_get_thread_cpu_time (entry->clock);
+
+    /* Forget the threads that are gone */
+    if (!GST_CLOCK_TIME_IS_VALID (now)) {
+      g_array_remove_index_fast (self->threads, i);
+      continue;
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID (entry->cpu_time) && now >= entry->cpu_time) {
+      *cpu_time += now - entry->cpu_time;
+    }
+    entry->cpu_time = now;
+    i++;
+  }
+  *n_threads = self->threads->len;
+  g_mutex_unlock (&self->thread_lock);
+
+  ret = TRUE;
+#endif
+  return ret;
+}
+
+static void
+gst_perf_bin_tick (gpointer data, GstClockTime elapsed)
+{
+  GstPerfBin *self;
+  GstStructure *structure;
+  GstPerfHistogramStats latency, run_latency;
+  GstClockTime cpu_time;
+  guint64 in_frames, in_bytes, out_frames, out_bytes;
+  guint n_threads, in_flight;
+  gdouble seconds;
+
+  g_return_if_fail (data);
+  g_return_if_fail (elapsed);
+
+  self = GST_PERF_BIN (data);
+  seconds = 1.0 * elapsed / GST_SECOND;
+
+  in_frames = gst_perf_atomic_u64_exchange (&self->in_frames,
+      G_GUINT64_CONSTANT (0));
+  in_bytes = gst_perf_atomic_u64_exchange (&self->in_bytes,
+      G_GUINT64_CONSTANT (0));
+  out_frames = gst_perf_atomic_u64_exchange (&self->out_frames,
+      G_GUINT64_CONSTANT (0));
+  out_bytes = gst_perf_atomic_u64_exchange (&self->out_bytes,
+      G_GUINT64_CONSTANT (0));
+
+  g_mutex_lock (&self->pending_lock);
+  in_flight = self->pending_length;
+  g_mutex_unlock (&self->pending_lock);
+
+  structure = gst_structure_new ("perfbin",
+      "timestamp", G_TYPE_UINT64, gst_util_get_timestamp (),
+      "in_fps", G_TYPE_DOUBLE, in_frames / seconds,
+      "in_bps", G_TYPE_DOUBLE,
+      in_bytes * GST_PERF_BIN_BITS_PER_BYTE / seconds,
+      "out_fps", G_TYPE_DOUBLE, out_frames / seconds,
+      "out_bps", G_TYPE_DOUBLE,
+      out_bytes * GST_PERF_BIN_BITS_PER_BYTE / seconds,
+      "in_flight", G_TYPE_UINT, in_flight, NULL);
+
+  gst_perf_histogram_report (self->latency_histogram,
+      &self->latency_snapshot, &self->latency_reported, &latency,
+      &run_latency);
+  gst_perf_histogram_stats_set_structure (structure, "latency", &latency);
+  gst_perf_histogram_stats_set_structure (structure, "run_latency",
+      &run_latency);
+
+  if (gst_perf_bin_sample_threads (self, &cpu_time, &n_threads)) {
+    gst_structure_set (structure,
+        "thread_cpu", G_TYPE_DOUBLE, 100.0 * cpu_time / elapsed,
+        "threads", G_TYPE_UINT, n_threads, NULL);
+  }
+
+  /* Only formatted if the debug level is enabled */
+  GST_INFO_OBJECT (self, "%" GST_PTR_FORMAT, structure);
+
+  gst_element_post_message (GST_ELEMENT (self),
+      gst_message_new_element (GST_OBJECT (self), structure));
+}
+
+static void
+gst_perf_bin_clear (GstPerfBin * self)
+{
+  gst_perf_atomic_u64_set (&self->in_frames, G_GUINT64_CONSTANT (0));
+  gst_perf_atomic_u64_set (&self->in_bytes, G_GUINT64_CONSTANT (0));
+  gst_perf_atomic_u64_set (&self->out_frames, G_GUINT64_CONSTANT (0));
+  gst_perf_atomic_u64_set (&self->out_bytes, G_GUINT64_CONSTANT (0));
+
+  g_mutex_lock (&self->pending_lock);
+  self->pending_head = 0;
+  self->pending_length = 0;
+  g_hash_table_remove_all (self->pending_by_pts);
+  g_hash_table_remove_all (self->pending_by_offset);
+  g_mutex_unlock (&self->pending_lock);
+
+  g_mutex_lock (&self->thread_lock);
+  if (self->threads) {
+    g_array_set_size (self->threads, 0);
+  }
+  self->sink_thread = 0;
+  self->src_thread = 0;
+  g_mutex_unlock (&self->thread_lock);
+}
+
+static gboolean
+gst_perf_bin_stop (GstPerfBin * self)
+{
+  if (self->ticker) {
+    gst_perf_ticker_free (self->ticker);
+    self->ticker = NULL;
+  }
+
+  gst_perf_bin_clear (self);
+
+  g_free (self->latency_histogram);
+  self->latency_histogram = NULL;
+  g_free (self->latency_snapshot);
+  self->latency_snapshot = NULL;
+  g_free (self->latency_reported);
+  self->latency_reported = NULL;
+
+  return TRUE;
+}
+
+static gboolean
+gst_perf_bin_start (GstPerfBin * self)
+{
+  guint interval;
+
+  if (NULL == self->child) {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL),
+        ("No element to measure, set the element property"));
+    return FALSE;
+  }
+
+  gst_perf_bin_clear (self);
+
+  self->latency_histogram = g_new0 (GstPerfHistogram, 1);
+  self->latency_snapshot = g_new0 (GstPerfHistogram, 1);
+  self->latency_reported = g_new0 (GstPerfHistogram, 1);
+
+  GST_OBJECT_LOCK (self);
+  interval = self->interval;
+  GST_OBJECT_UNLOCK (self);
+
+  if (!interval) {
+    GST_WARNING_OBJECT (self, "Interval is 0, using %d ms", DEFAULT_INTERVAL);
+    interval = DEFAULT_INTERVAL;
+  }
+
+  self->ticker = gst_perf_ticker_new ("perfbin", interval,
+      gst_perf_bin_tick, self);
+  if (!self->ticker) {
+    GST_ERROR_OBJECT (self, "Unable to start the statistics timer");
+    gst_perf_bin_stop (self);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstStateChangeReturn
+gst_perf_bin_change_state (GstElement * element, GstStateChange transition)
+{
+  GstPerfBin *self = GST_PERF_BIN (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_perf_bin_start (self)) {
+        return GST_STATE_CHANGE_FAILURE;
+      }
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (GST_STATE_CHANGE_FAILURE == ret) {
+    if (GST_STATE_CHANGE_READY_TO_PAUSED == transition) {
+      gst_perf_bin_stop (self);
+    }
+    return ret;
+  }
+
+  /* The child pads are deactivated by now, no probe is running */
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_perf_bin_stop (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
@@ -0,0 +1,43 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_BIN_H_
+#define _GST_PERF_BIN_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define GST_TYPE_PERF_BIN \
+  (gst_perf_bin_get_type())
+#define GST_PERF_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PERF_BIN,GstPerfBin))
+#define GST_PERF_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_PERF_BIN,GstPerfBinClass))
+#define GST_IS_PERF_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PERF_BIN))
+#define GST_IS_PERF_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_PERF_BIN))
+
+typedef struct _GstPerfBin GstPerfBin;
+typedef struct _GstPerfBinClass GstPerfBinClass;
+
+GType gst_perf_bin_get_type (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,229 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfhistogram.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Enough for the structure field names we build */
+#define GST_PERF_HISTOGRAM_FIELD_MAX_SIZE 32
+
+static guint64
+gst_perf_histogram_lowest_value (guint idx)
+{
+  guint shift, sub;
+
+  if (idx < GST_PERF_HISTOGRAM_SUB_COUNT) {
+    return idx;
+  }
+
+  idx -= GST_PERF_HISTOGRAM_SUB_COUNT;
+  shift = idx / GST_PERF_HISTOGRAM_HALF_COUNT + 1;
+  sub = idx % GST_PERF_HISTOGRAM_HALF_COUNT + GST_PERF_HISTOGRAM_HALF_COUNT;
+
+  return (guint64) sub << shift;
+}
+
+static guint64
+gst_perf_histogram_highest_value (guint idx)
+{
+  guint shift;
+
+  if (idx < GST_PERF_HISTOGRAM_SUB_COUNT) {
+    return idx;
+  }
+
+  shift = (idx - GST_PERF_HISTOGRAM_SUB_COUNT) /
+      GST_PERF_HISTOGRAM_HALF_COUNT + 1;
+
+  return gst_perf_histogram_lowest_value (idx) +
+      (G_GUINT64_CONSTANT (1) << shift) - 1;
+}
+
+static guint64
+gst_perf_histogram_bucket_count (const GstPerfHistogram * histogram,
+    const GstPerfHistogram * base, guint idx)
+{
+  return histogram->counts[idx] - (base ? base->counts[idx] : 0);
+}
+
+void
+gst_perf_histogram_reset (GstPerfHistogram * histogram)
+{
+  g_return_if_fail (histogram);
+
+  memset (histogram, 0, sizeof (GstPerfHistogram));
+}
+
+/**
+ * gst_perf_histogram_snapshot:
+ * @histogram: a histogram that may be recorded into concurrently
+ * @snapshot: (out): where to copy it
+ *
+ * Copies @histogram bucket by bucket. The total count is recomputed from
+ * the copied buckets so the snapshot is self consistent even if values
+ * were recorded while copying.
+ */
+void
+gst_perf_histogram_snapshot (GstPerfHistogram * histogram,
+    GstPerfHistogram * snapshot)
+{
+  guint i;
+
+  g_return_if_fail (histogram);
+  g_return_if_fail (snapshot);
+
+  snapshot->count = 0;
+  for (i = 0; i < GST_PERF_HISTOGRAM_BUCKETS; i++) {
+    snapshot->counts[i] = gst_perf_atomic_u64_get (&histogram->counts[i]);
+    snapshot->count += snapshot->counts[i];
+  }
+}
+
+/**
+ * gst_perf_histogram_get_stats:
+ * @histogram: the histogram
+ * @base: (nullable): an earlier copy of @histogram
+ * @stats: (out): the resulting statistics
+ *
+ * Computes the statistics of the values recorded in @histogram since
+ * @base was copied from it, or of all of them if @base is %NULL. Values
+ * are reported at bucket precision and the standard deviation uses the
+ * bucket midpoints.
+ */
+void
+gst_perf_histogram_get_stats (const GstPerfHistogram * histogram,
+    const GstPerfHistogram * base, GstPerfHistogramStats * stats)
+{
+  const gdouble percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+  guint64 *targets[] = { &stats->p50, &stats->p90, &stats->p99,
+    &stats->p999
+  };
+  guint64 count, seen = 0;
+  gdouble sum = 0, sum_squares = 0, mean;
+  guint i, next = 0;
+
+  g_return_if_fail (histogram);
+  g_return_if_fail (stats);
+
+  memset (stats, 0, sizeof (GstPerfHistogramStats));
+
+  count = histogram->count - (base ? base->count : 0);
+  if (!count) {
+    return;
+  }
+  stats->count = count;
+
+  for (i = 0; i < GST_PERF_HISTOGRAM_BUCKETS; i++) {
+    guint64 bucket = gst_perf_histogram_bucket_count (histogram, base, i);
+    gdouble middle;
+
+    if (!bucket) {
+      continue;
+    }
+
+    if (!seen) {
+      stats->min = gst_perf_histogram_lowest_value (i);
+    }
+    stats->max = gst_perf_histogram_highest_value (i);
+
+    seen += bucket;
+    while (next < G_N_ELEMENTS (percentiles) &&
+        seen >= ceil (percentiles[next] * count / 100.0)) {
+      *targets[next] = stats->max;
+      next++;
+    }
+
+    middle = (gst_perf_histogram_lowest_value (i) + stats->max) / 2.0;
+    sum += bucket * middle;
+    sum_squares += bucket * middle * middle;
+  }
+
+  mean = sum / count;
+  stats->stddev = sqrt (MAX (sum_squares / count - mean * mean, 0.0));
+}
+
+/**
+ * gst_perf_histogram_report:
+ * @histogram: a histogram that may be recorded into concurrently
+ * @snapshot: (inout): scratch histogram
+ * @reported: (inout): the snapshot of the previous report
+ * @interval: (out): statistics since the previous report
+ * @run: (out): statistics of the whole run
+ *
+ * Snapshots @histogram, computes the statistics of the interval and of the
+ * whole run, and keeps the snapshot as the base of the next interval by
+ * swapping @snapshot and @reported.
+ */
+void
+gst_perf_histogram_report (GstPerfHistogram * histogram,
+    GstPerfHistogram ** snapshot, GstPerfHistogram ** reported,
+    GstPerfHistogramStats * interval, GstPerfHistogramStats * run)
+{
+  GstPerfHistogram *base;
+
+  g_return_if_fail (histogram);
+  g_return_if_fail (snapshot && *snapshot);
+  g_return_if_fail (reported && *reported);
+
+  gst_perf_histogram_snapshot (histogram, *snapshot);
+  gst_perf_histogram_get_stats (*snapshot, *reported, interval);
+  gst_perf_histogram_get_stats (*snapshot, NULL, run);
+
+  base = *reported;
+  *reported = *snapshot;
+  *snapshot = base;
+}
+
+/**
+ * gst_perf_histogram_stats_set_structure:
+ * @structure: the structure to fill
+ * @prefix: prefix of the field names
+ * @stats: the statistics
+ *
+ * Sets @stats in @structure as <prefix>_min, <prefix>_p50 and so on, in
+ * nanoseconds, plus <prefix>_stddev.
+ */
+void
+gst_perf_histogram_stats_set_structure (GstStructure * structure,
+    const gchar * prefix, const GstPerfHistogramStats * stats)
+{
+  const gchar *names[] = { "min", "p50", "p90", "p99", "p999", "max" };
+  const guint64 values[] = { stats->min, stats->p50, stats->p90, stats->p99,
+    stats->p999, stats->max
+  };
+  gchar field[GST_PERF_HISTOGRAM_FIELD_MAX_SIZE];
+  guint i;
+
+  g_return_if_fail (structure);
+  g_return_if_fail (prefix);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++) {
+    g_snprintf (field, sizeof (field), "%s_%s", prefix, names[i]);
+    gst_structure_set (structure, field, G_TYPE_UINT64, values[i], NULL);
+  }
+
+  g_snprintf (field, sizeof (field), "%s_stddev", prefix);
+  gst_structure_set (structure, field, G_TYPE_DOUBLE, stats->stddev, NULL);
+}
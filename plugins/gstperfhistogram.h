@@ -0,0 +1,110 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_HISTOGRAM_H_
+#define _GST_PERF_HISTOGRAM_H_
+
+#include <gst/gst.h>
+
+#include "gstperfatomic.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Log-linear histogram in the spirit of HdrHistogram. Values below
+ * 2^SUB_BITS get a bucket each, above that every power of two is split in
+ * 2^(SUB_BITS - 1) linear buckets, so the relative error is below
+ * 1/2^(SUB_BITS - 1), under 1% with 8 bits for about 30 KB of counters.
+ * Values above 2^MAX_BITS - 1 are clamped, which for nanoseconds is about
+ * 68 s.
+ */
+#define GST_PERF_HISTOGRAM_SUB_BITS 8
+#define GST_PERF_HISTOGRAM_MAX_BITS 36
+#define GST_PERF_HISTOGRAM_SUB_COUNT (1 << GST_PERF_HISTOGRAM_SUB_BITS)
+#define GST_PERF_HISTOGRAM_HALF_COUNT (GST_PERF_HISTOGRAM_SUB_COUNT / 2)
+#define GST_PERF_HISTOGRAM_MAX_VALUE \
+  ((G_GUINT64_CONSTANT (1) << GST_PERF_HISTOGRAM_MAX_BITS) - 1)
+#define GST_PERF_HISTOGRAM_BUCKETS (GST_PERF_HISTOGRAM_SUB_COUNT + \
+    (GST_PERF_HISTOGRAM_MAX_BITS - GST_PERF_HISTOGRAM_SUB_BITS) * \
+    GST_PERF_HISTOGRAM_HALF_COUNT)
+
+typedef struct _GstPerfHistogram
+{
+  guint64 count;
+  guint64 counts[GST_PERF_HISTOGRAM_BUCKETS];
+} GstPerfHistogram;
+
+typedef struct _GstPerfHistogramStats
+{
+  guint64 count;
+  guint64 min;
+  guint64 p50;
+  guint64 p90;
+  guint64 p99;
+  guint64 p999;
+  guint64 max;
+  gdouble stddev;
+} GstPerfHistogramStats;
+
+static inline guint
+gst_perf_histogram_index (guint64 value)
+{
+  guint msb, shift;
+
+  if (value < GST_PERF_HISTOGRAM_SUB_COUNT) {
+    return value;
+  }
+
+  if (value > GST_PERF_HISTOGRAM_MAX_VALUE) {
+    value = GST_PERF_HISTOGRAM_MAX_VALUE;
+  }
+
+  msb = 63 - __builtin_clzll (value);
+  shift = msb - GST_PERF_HISTOGRAM_SUB_BITS + 1;
+
+  return GST_PERF_HISTOGRAM_SUB_COUNT +
+      (shift - 1) * GST_PERF_HISTOGRAM_HALF_COUNT +
+      ((value >> shift) - GST_PERF_HISTOGRAM_HALF_COUNT);
+}
+
+/*
+ * Constant time, meant to be called from the streaming thread. The
+ * increments are atomic so another thread can take a snapshot meanwhile.
+ */
+static inline void
+gst_perf_histogram_record (GstPerfHistogram * histogram, guint64 value)
+{
+  gst_perf_atomic_u64_add (&histogram->counts[gst_perf_histogram_index
+          (value)], 1);
+  gst_perf_atomic_u64_add (&histogram->count, 1);
+}
+
+void gst_perf_histogram_reset (GstPerfHistogram * histogram);
+void gst_perf_histogram_snapshot (GstPerfHistogram * histogram,
+    GstPerfHistogram * snapshot);
+void gst_perf_histogram_get_stats (const GstPerfHistogram * histogram,
+    const GstPerfHistogram * base, GstPerfHistogramStats * stats);
+void gst_perf_histogram_report (GstPerfHistogram * histogram,
+    GstPerfHistogram ** snapshot, GstPerfHistogram ** reported,
+    GstPerfHistogramStats * interval, GstPerfHistogramStats * run);
+void gst_perf_histogram_stats_set_structure (GstStructure * structure,
+    const gchar * prefix, const GstPerfHistogramStats * stats);
+
+G_END_DECLS
+#endif
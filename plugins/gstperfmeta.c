@@ -0,0 +1,104 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfmeta.h"
+
+static gboolean
+gst_perf_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  GstPerfMeta *perf_meta = (GstPerfMeta *) meta;
+
+  perf_meta->timestamp = GST_CLOCK_TIME_NONE;
+  perf_meta->id = 0;
+  perf_meta->seqnum = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_perf_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstPerfMeta *perf_meta = (GstPerfMeta *) meta;
+
+  /* The arrival time is still valid whatever was done to the content */
+  return gst_buffer_add_perf_meta (dest, perf_meta->timestamp, perf_meta->id,
+      perf_meta->seqnum) != NULL;
+}
+
+GType
+gst_perf_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstPerfMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_perf_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_PERF_META_API_TYPE,
+        "GstPerfMeta", sizeof (GstPerfMeta), gst_perf_meta_init, NULL,
+        gst_perf_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+/**
+ * gst_buffer_add_perf_meta:
+ * @buffer: a writable #GstBuffer
+ * @timestamp: the ingress time
+ * @id: the ingress element id
+ * @seqnum: the buffer sequence number
+ *
+ * Returns: (transfer none): the #GstPerfMeta added to @buffer.
+ */
+GstPerfMeta *
+gst_buffer_add_perf_meta (GstBuffer * buffer, GstClockTime timestamp,
+    GQuark id, guint64 seqnum)
+{
+  GstPerfMeta *perf_meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  perf_meta = (GstPerfMeta *) gst_buffer_add_meta (buffer,
+      GST_PERF_META_INFO, NULL);
+  if (!perf_meta) {
+    return NULL;
+  }
+
+  perf_meta->timestamp = timestamp;
+  perf_meta->id = id;
+  perf_meta->seqnum = seqnum;
+
+  return perf_meta;
+}
@@ -0,0 +1,63 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_META_H_
+#define _GST_PERF_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_PERF_META_API_TYPE (gst_perf_meta_api_get_type())
+#define GST_PERF_META_INFO (gst_perf_meta_get_info())
+
+typedef struct _GstPerfMeta GstPerfMeta;
+
+/**
+ * GstPerfMeta:
+ * @meta: parent #GstMeta
+ * @timestamp: gst_util_get_timestamp() when the buffer went through the
+ *     ingress perf element
+ * @id: quark of the ingress perf element name
+ * @seqnum: sequence number of the buffer in the ingress perf element
+ *
+ * Stamped by a perf element with latency-role=ingress, and read by a
+ * downstream perf element with latency-role=egress to measure the transit
+ * time in between.
+ */
+struct _GstPerfMeta
+{
+  GstMeta meta;
+
+  GstClockTime timestamp;
+  GQuark id;
+  guint64 seqnum;
+};
+
+GType gst_perf_meta_api_get_type (void);
+const GstMetaInfo *gst_perf_meta_get_info (void);
+
+#define gst_buffer_get_perf_meta(b) \
+  ((GstPerfMeta*)gst_buffer_get_meta((b),GST_PERF_META_API_TYPE))
+
+GstPerfMeta *gst_buffer_add_perf_meta (GstBuffer * buffer,
+    GstClockTime timestamp, GQuark id, guint64 seqnum);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,125 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfprocfs.h"
+
+/* procfs only exists on Linux, the reader is not built anywhere else */
+#ifdef IS_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_perf_debug);
+#define GST_CAT_DEFAULT gst_perf_debug
+
+/* Fits /proc/stat on most machines, larger files grow the buffer once */
+#define GST_PERF_PROC_FILE_INITIAL_SIZE 8192
+
+struct _GstPerfProcFile
+{
+  gchar *path;
+  gint fd;
+
+  gchar *buffer;
+  gsize size;
+};
+
+GstPerfProcFile *
+gst_perf_proc_file_open (const gchar * path)
+{
+  GstPerfProcFile *file;
+  gint fd;
+
+  g_return_val_if_fail (path, NULL);
+
+  fd = open (path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    GST_WARNING ("Unable to open %s: %s", path, g_strerror (errno));
+    return NULL;
+  }
+
+  file = g_new0 (GstPerfProcFile, 1);
+  file->path = g_strdup (path);
+  file->fd = fd;
+  file->size = GST_PERF_PROC_FILE_INITIAL_SIZE;
+  file->buffer = g_malloc (file->size);
+
+  return file;
+}
+
+void
+gst_perf_proc_file_close (GstPerfProcFile * file)
+{
+  g_return_if_fail (file);
+
+  close (file->fd);
+  g_free (file->buffer);
+  g_free (file->path);
+  g_free (file);
+}
+
+/*
+ * Reads the whole file and returns its NUL terminated contents. The
+ * buffer belongs to @file and is only valid until the next read.
+ */
+const gchar *
+gst_perf_proc_file_read (GstPerfProcFile * file)
+{
+  gsize filled = 0;
+  gssize ret;
+
+  g_return_val_if_fail (file, NULL);
+
+  while (TRUE) {
+    ret = pread (file->fd, &file->buffer[filled], file->size - filled - 1,
+        filled);
+
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      GST_WARNING ("Unable to read %s: %s", file->path, g_strerror (errno));
+      return NULL;
+    }
+
+    filled += ret;
+
+    /*
+     * procfs hands out as much as fits, so a short read means we got
+     * everything. Only a full buffer needs another round.
+     */
+    if (0 == ret || filled < file->size - 1) {
+      break;
+    }
+
+    file->size *= 2;
+    file->buffer = g_realloc (file->buffer, file->size);
+  }
+
+  file->buffer[filled] = '\0';
+
+  return file->buffer;
+}
+
+#endif /* IS_LINUX */
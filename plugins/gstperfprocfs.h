@@ -0,0 +1,80 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_PROCFS_H_
+#define _GST_PERF_PROCFS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A procfs file kept open across samples. Every read is a single pread
+ * from offset 0 into a buffer that is reused and only grows, so sampling
+ * does not open, allocate or go through stdio.
+ */
+typedef struct _GstPerfProcFile GstPerfProcFile;
+
+GstPerfProcFile *gst_perf_proc_file_open (const gchar * path);
+void gst_perf_proc_file_close (GstPerfProcFile * file);
+const gchar *gst_perf_proc_file_read (GstPerfProcFile * file);
+
+/*
+ * Skips leading blanks and parses a decimal integer. Returns the position
+ * right after the digits, or NULL if there was no number.
+ */
+static inline const gchar *
+gst_perf_proc_parse_u64 (const gchar * str, guint64 * value)
+{
+  guint64 v = 0;
+
+  while (*str == ' ' || *str == '\t') {
+    str++;
+  }
+
+  if (*str < '0' || *str > '9') {
+    return NULL;
+  }
+
+  do {
+    v = v * 10 + (*str - '0');
+    str++;
+  } while (*str >= '0' && *str <= '9');
+
+  *value = v;
+
+  return str;
+}
+
+/* Returns the start of the next line, or NULL at the end of the buffer */
+static inline const gchar *
+gst_perf_proc_next_line (const gchar * str)
+{
+  while (*str != '\n') {
+    if (*str == '\0') {
+      return NULL;
+    }
+    str++;
+  }
+
+  return str + 1;
+}
+
+G_END_DECLS
+#endif
@@ -0,0 +1,202 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfrecorder.h"
+
+#include <string.h>
+
+#ifdef G_OS_UNIX
+#  include <errno.h>
+#  include <signal.h>
+#endif
+
+GST_DEBUG_CATEGORY_EXTERN (gst_perf_debug);
+#define GST_CAT_DEFAULT gst_perf_debug
+
+#ifdef G_OS_UNIX
+static volatile sig_atomic_t gst_perf_recorder_sigusr1_count;
+static struct sigaction gst_perf_recorder_old_action;
+#endif
+
+/**
+ * gst_perf_recorder_new:
+ * @size: minimum number of records to keep, rounded up to a power of two,
+ *   at most %GST_PERF_RECORDER_MAX_SIZE
+ *
+ * Returns: a new empty recorder, all of its memory allocated up front.
+ */
+GstPerfRecorder *
+gst_perf_recorder_new (guint size)
+{
+  GstPerfRecorder *recorder;
+  guint64 capacity;
+
+  g_return_val_if_fail (size, NULL);
+  g_return_val_if_fail (size <= GST_PERF_RECORDER_MAX_SIZE, NULL);
+
+  /* A power of two turns the modulo in the hot path into a mask */
+  capacity = G_GUINT64_CONSTANT (1) << g_bit_storage (size - 1);
+
+  recorder = g_new0 (GstPerfRecorder, 1);
+  recorder->mask = capacity - 1;
+  recorder->records = g_new0 (GstPerfRecord, capacity);
+
+  return recorder;
+}
+
+void
+gst_perf_recorder_free (GstPerfRecorder * recorder)
+{
+  g_return_if_fail (recorder);
+
+  g_free (recorder->records);
+  g_free (recorder);
+}
+
+/**
+ * gst_perf_recorder_dump:
+ * @recorder: the recorder, may be written to concurrently
+ * @location: the file to write
+ * @trigger: #GstPerfRecorderTrigger bits to store in the header
+ * @count: (out) (optional): the number of records written
+ * @error: return location for a #GError
+ *
+ * Writes a #GstPerfRecordHeader followed by the records in the ring,
+ * oldest first. Records the writer may have replaced during the copy, and
+ * the one it may be writing, are left out.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gst_perf_recorder_dump (GstPerfRecorder * recorder, const gchar * location,
+    guint32 trigger, guint64 * count, GError ** error)
+{
+  GstPerfRecordHeader *header;
+  GstPerfRecord *records;
+  guint64 capacity, head, first, valid, n, i;
+  gchar *data;
+  gboolean ret;
+
+  g_return_val_if_fail (recorder, FALSE);
+  g_return_val_if_fail (location, FALSE);
+
+  capacity = recorder->mask + 1;
+
+  /* The newest claimed record may still be in progress */
+  head = __atomic_load_n (&recorder->head, __ATOMIC_ACQUIRE);
+  head = head ? head - 1 : 0;
+  first = head > capacity ? head - capacity : 0;
+  n = head - first;
+
+  data = g_malloc (sizeof (GstPerfRecordHeader) + n * sizeof (GstPerfRecord));
+  header = (GstPerfRecordHeader *) data;
+  records = (GstPerfRecord *) (data + sizeof (GstPerfRecordHeader));
+
+  for (i = 0; i < n; i++) {
+    records[i] = recorder->records[(first + i) & recorder->mask];
+  }
+
+  /* Anything claimed meanwhile may have overwritten the oldest copies */
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+  valid = __atomic_load_n (&recorder->head, __ATOMIC_RELAXED);
+  valid = valid > capacity ? valid - capacity : 0;
+  if (valid > first) {
+    guint64 skip = MIN (valid - first, n);
+
+    n -= skip;
+    memmove (records, records + skip, n * sizeof (GstPerfRecord));
+  }
+
+  memset (header, 0, sizeof (GstPerfRecordHeader));
+  memcpy (header->magic, GST_PERF_RECORDER_MAGIC, sizeof (header->magic));
+  header->version = GST_PERF_RECORDER_VERSION;
+  header->record_size = sizeof (GstPerfRecord);
+  header->count = n;
+  header->trigger = trigger;
+
+  ret = g_file_set_contents (location, data,
+      sizeof (GstPerfRecordHeader) + n * sizeof (GstPerfRecord), error);
+  g_free (data);
+
+  if (count) {
+    *count = n;
+  }
+
+  return ret;
+}
+
+#ifdef G_OS_UNIX
+static void
+gst_perf_recorder_sigusr1_handler (int signum)
+{
+  gst_perf_recorder_sigusr1_count++;
+
+  /* Keep whatever the application had installed working */
+  if (!(gst_perf_recorder_old_action.sa_flags & SA_SIGINFO) &&
+      gst_perf_recorder_old_action.sa_handler != SIG_DFL &&
+      gst_perf_recorder_old_action.sa_handler != SIG_IGN) {
+    gst_perf_recorder_old_action.sa_handler (signum);
+  }
+}
+#endif
+
+/**
+ * gst_perf_recorder_watch_sigusr1:
+ *
+ * Installs a SIGUSR1 handler that only counts the signals, once per
+ * process. Timers poll gst_perf_recorder_get_sigusr1_count() and do the
+ * actual work outside of the signal handler.
+ */
+void
+gst_perf_recorder_watch_sigusr1 (void)
+{
+#ifdef G_OS_UNIX
+  static gsize installed = 0;
+
+  if (g_once_init_enter (&installed)) {
+    struct sigaction action;
+
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = gst_perf_recorder_sigusr1_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset (&action.sa_mask);
+
+    if (0 != sigaction (SIGUSR1, &action, &gst_perf_recorder_old_action)) {
+      GST_WARNING ("Unable to install the SIGUSR1 handler: %s",
+          g_strerror (errno));
+    }
+
+    g_once_init_leave (&installed, 1);
+  }
+#endif
+}
+
+guint
+gst_perf_recorder_get_sigusr1_count (void)
+{
+#ifdef G_OS_UNIX
+  return gst_perf_recorder_sigusr1_count;
+#else
+  return 0;
+#endif
+}
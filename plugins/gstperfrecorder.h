@@ -0,0 +1,129 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_RECORDER_H_
+#define _GST_PERF_RECORDER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* What made a flight recorder dump, as a bitmask */
+typedef enum
+{
+  GST_PERF_RECORDER_TRIGGER_FPS = (1 << 0),
+  GST_PERF_RECORDER_TRIGGER_GAP = (1 << 1),
+  GST_PERF_RECORDER_TRIGGER_ACTION = (1 << 2),
+  GST_PERF_RECORDER_TRIGGER_SIGNAL = (1 << 3)
+} GstPerfRecorderTrigger;
+
+#define GST_PERF_RECORDER_MAGIC "GSTPERFR"
+#define GST_PERF_RECORDER_VERSION 1
+/* 2 MB of records, still some seconds of a high rate stream */
+#define GST_PERF_RECORDER_MAX_SIZE 65536
+
+/**
+ * GstPerfRecordHeader:
+ * @magic: GST_PERF_RECORDER_MAGIC, not NUL terminated
+ * @version: GST_PERF_RECORDER_VERSION
+ * @record_size: size of a #GstPerfRecord, to skip unknown trailing fields
+ * @count: number of records following the header, oldest first
+ * @trigger: the #GstPerfRecorderTrigger bits that caused the dump
+ *
+ * Start of a dump file. Everything is in host byte order.
+ */
+typedef struct _GstPerfRecordHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 record_size;
+  guint64 count;
+  guint32 trigger;
+  guint32 reserved;
+} GstPerfRecordHeader;
+
+/**
+ * GstPerfRecord:
+ * @arrival: when the buffer reached perf, from gst_util_get_timestamp()
+ * @pts: the buffer PTS
+ * @thread_cpu: CPU time of the streaming thread, or GST_CLOCK_TIME_NONE
+ * @size: the buffer size in bytes
+ * @flags: the buffer #GstBufferFlags
+ */
+typedef struct _GstPerfRecord
+{
+  guint64 arrival;
+  guint64 pts;
+  guint64 thread_cpu;
+  guint32 size;
+  guint32 flags;
+} GstPerfRecord;
+
+/*
+ * Preallocated ring of the last records, written by a single thread
+ * without locks and copied by any other thread. head counts the records
+ * ever claimed, a record is claimed before it is written so a reader can
+ * tell which ones may have changed while it copied them.
+ */
+typedef struct _GstPerfRecorder
+{
+  guint64 head;
+  guint64 mask;
+  GstPerfRecord *records;
+} GstPerfRecorder;
+
+/* Only a few stores, meant to be called from the streaming thread */
+static inline GstPerfRecord *
+gst_perf_recorder_claim (GstPerfRecorder * recorder)
+{
+  guint64 head = recorder->head;
+
+  __atomic_store_n (&recorder->head, head + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+
+  return &recorder->records[head & recorder->mask];
+}
+
+/* The record before the one being written, or NULL */
+static inline const GstPerfRecord *
+gst_perf_recorder_previous (GstPerfRecorder * recorder)
+{
+  guint64 head = recorder->head;
+
+  return head ? &recorder->records[(head - 1) & recorder->mask] : NULL;
+}
+
+/* Number of records ever written, safe from any thread */
+static inline guint64
+gst_perf_recorder_get_count (GstPerfRecorder * recorder)
+{
+  return __atomic_load_n (&recorder->head, __ATOMIC_ACQUIRE);
+}
+
+GstPerfRecorder *gst_perf_recorder_new (guint size);
+void gst_perf_recorder_free (GstPerfRecorder * recorder);
+gboolean gst_perf_recorder_dump (GstPerfRecorder * recorder,
+    const gchar * location, guint32 trigger, guint64 * count,
+    GError ** error);
+
+void gst_perf_recorder_watch_sigusr1 (void);
+guint gst_perf_recorder_get_sigusr1_count (void);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,500 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfsampler.h"
+#include "gstperfprocfs.h"
+#include "gstperfutils.h"
+
+#ifdef IS_MACOSX
+#  include <mach/mach_init.h>
+#  include <mach/mach_error.h>
+#  include <mach/mach_host.h>
+#  include <mach/vm_map.h>
+#endif
+
+#ifdef IS_LINUX
+#  include <unistd.h>
+#endif
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_perf_debug);
+#define GST_CAT_DEFAULT gst_perf_debug
+
+/* System metrics are sampled once per second for the whole process */
+#define GST_PERF_SAMPLER_INTERVAL 1000
+
+/* Fields of a /proc/stat cpu line summed into the total, up to steal */
+#define GST_PERF_CPU_FIELDS 8
+/* Sanity bound on the N of cpuN */
+#define GST_PERF_MAX_CORES 4096
+
+struct _GstPerfSampler
+{
+  GstPerfTicker *ticker;
+
+  /* Previous counters, only touched by the ticker once it runs */
+  guint64 prev_cpu_total;
+  guint64 prev_cpu_idle;
+  guint n_cores;
+  guint64 *prev_core_total;
+  guint64 *prev_core_idle;
+
+#ifdef IS_LINUX
+  GstPerfProcFile *stat;
+  GstPerfProcFile *meminfo;
+  GstPerfProcFile *statm;
+  guint64 page_size;
+#endif
+
+  /* Latest published sample, protected by lock */
+  GMutex lock;
+  GstPerfSample *sample;
+};
+
+/* The one sampler of the process and its users, protected by sampler_lock */
+static GMutex sampler_lock;
+static GstPerfSampler *sampler = NULL;
+static guint sampler_users = 0;
+
+GstPerfSample *
+gst_perf_sample_ref (GstPerfSample * sample)
+{
+  g_return_val_if_fail (sample, NULL);
+
+  g_atomic_int_inc (&sample->refcount);
+
+  return sample;
+}
+
+void
+gst_perf_sample_unref (GstPerfSample * sample)
+{
+  g_return_if_fail (sample);
+
+  if (g_atomic_int_dec_and_test (&sample->refcount)) {
+    g_free (sample->core_load);
+    g_free (sample);
+  }
+}
+
+static guint32
+gst_perf_compute_cpu (guint64 * prev_idle, guint64 * prev_total,
+    guint64 current_idle, guint64 current_total)
+{
+  guint64 busy = 0;
+  guint64 idle = 0;
+  guint64 total = 0;
+
+  g_return_val_if_fail (prev_idle, -1);
+  g_return_val_if_fail (prev_total, -1);
+
+  /* Counters narrower than 64 bits may wrap, start over from here */
+  if (current_total < *prev_total || current_idle < *prev_idle) {
+    *prev_total = current_total;
+    *prev_idle = current_idle;
+    return 0;
+  }
+
+  /* Calculate the CPU usage since last time we checked */
+  idle = current_idle - *prev_idle;
+  total = current_total - *prev_total;
+
+  /* Update the total and idle CPU for the next check */
+  *prev_total = current_total;
+  *prev_idle = current_idle;
+
+  /* Avoid a divison by zero */
+  if (0 == total) {
+    return 0;
+  }
+
+  /* - CPU usage is the fraction of time the processor spent busy:
+   * [0.0, 1.0].
+   *
+   * - We want to express this as a percentage [0% - 100%].
+   *
+   * - We want to avoid, when possible, using floating
+   * point operations (some SoC still don't have a FP unit).
+   *
+   * - Scaling to 1000 allows us round (nearest interger) by summing
+   * 5 and then scaling down back to 100 by dividing by
+   * 10. Othersise we would've lost the decimals due to integer
+   * truncating.
+   */
+  busy = total - idle;
+  return (1000 * busy / total + 5) / 10;
+}
+
+#ifdef IS_LINUX
+static void
+gst_perf_sampler_update_core (GstPerfSampler * self, GstPerfSample * sample,
+    guint core, guint64 idle, guint64 total)
+{
+  /* Cores can show up late (hotplug), grow the arrays as needed */
+  if (core >= self->n_cores) {
+    guint n_cores = core + 1;
+
+    self->prev_core_total = g_renew (guint64, self->prev_core_total, n_cores);
+    self->prev_core_idle = g_renew (guint64, self->prev_core_idle, n_cores);
+    memset (&self->prev_core_total[self->n_cores], 0,
+        (n_cores - self->n_cores) * sizeof (guint64));
+    memset (&self->prev_core_idle[self->n_cores], 0,
+        (n_cores - self->n_cores) * sizeof (guint64));
+    self->n_cores = n_cores;
+  }
+
+  if (core >= sample->n_cores) {
+    guint n_cores = core + 1;
+
+    sample->core_load = g_renew (gint, sample->core_load, n_cores);
+    memset (&sample->core_load[sample->n_cores], 0,
+        (n_cores - sample->n_cores) * sizeof (gint));
+    sample->n_cores = n_cores;
+  }
+
+  sample->core_load[core] = gst_perf_compute_cpu (&self->prev_core_idle[core],
+      &self->prev_core_total[core], idle, total);
+}
+
+static void
+gst_perf_sampler_read_cpu (GstPerfSampler * self, GstPerfSample * sample)
+{
+  guint64 fields[GST_PERF_CPU_FIELDS];
+  guint64 total;
+  guint64 core = 0;
+  gboolean is_core;
+  const gchar *line;
+  const gchar *cursor;
+  guint i;
+
+  if (NULL == self->stat) {
+    return;
+  }
+
+  line = gst_perf_proc_file_read (self->stat);
+  if (NULL == line) {
+    GST_ERROR ("Failed to get the CPU load");
+    return;
+  }
+
+  /*
+   * The aggregate "cpu" line comes first, followed by one "cpuN" line per
+   * core: user nice system idle iowait irq softirq steal ...
+   */
+  for (; line && g_str_has_prefix (line, "cpu");
+      line = gst_perf_proc_next_line (line)) {
+    cursor = line + 3;
+
+    is_core = g_ascii_isdigit (*cursor);
+    if (is_core) {
+      cursor = gst_perf_proc_parse_u64 (cursor, &core);
+    }
+
+    /*Calculate the total CPU time */
+    total = 0;
+    for (i = 0; cursor && i < GST_PERF_CPU_FIELDS; i++) {
+      cursor = gst_perf_proc_parse_u64 (cursor, &fields[i]);
+      total += fields[i];
+    }
+
+    if (NULL == cursor) {
+      continue;
+    }
+
+    if (is_core) {
+      if (core < GST_PERF_MAX_CORES) {
+        gst_perf_sampler_update_core (self, sample, core, fields[3], total);
+      }
+      continue;
+    }
+
+    GST_DEBUG ("CPU stats-> user: %" G_GUINT64_FORMAT "; nice: %"
+        G_GUINT64_FORMAT "; sys: %" G_GUINT64_FORMAT "; idle: %"
+        G_GUINT64_FORMAT "; iowait: %" G_GUINT64_FORMAT "; irq: %"
+        G_GUINT64_FORMAT "; softirq: %" G_GUINT64_FORMAT "; steal: %"
+        G_GUINT64_FORMAT, fields[0], fields[1], fields[2], fields[3],
+        fields[4], fields[5], fields[6], fields[7]);
+
+    sample->cpu_load = gst_perf_compute_cpu (&self->prev_cpu_idle,
+        &self->prev_cpu_total, fields[3], total);
+  }
+}
+
+static void
+gst_perf_sampler_read_memory (GstPerfSampler * self, GstPerfSample * sample)
+{
+  const gchar *line;
+  guint64 pages;
+
+  /* Lines look like "MemAvailable:   1234 kB" */
+  line = self->meminfo ? gst_perf_proc_file_read (self->meminfo) : NULL;
+  for (; line; line = gst_perf_proc_next_line (line)) {
+    if (g_str_has_prefix (line, "MemTotal:")) {
+      if (gst_perf_proc_parse_u64 (line + sizeof ("MemTotal:") - 1,
+              &sample->mem_total)) {
+        sample->mem_total *= 1024;
+      }
+    } else if (g_str_has_prefix (line, "MemAvailable:")) {
+      if (gst_perf_proc_parse_u64 (line + sizeof ("MemAvailable:") - 1,
+              &sample->mem_available)) {
+        sample->mem_available *= 1024;
+      }
+      break;
+    }
+  }
+
+  /* The second field is the resident set, in pages */
+  line = self->statm ? gst_perf_proc_file_read (self->statm) : NULL;
+  if (line) {
+    line = gst_perf_proc_parse_u64 (line, &pages);
+  }
+  if (line && gst_perf_proc_parse_u64 (line, &pages)) {
+    sample->rss = pages * self->page_size;
+  }
+}
+
+#elif IS_MACOSX
+static void
+gst_perf_sampler_read_cpu (GstPerfSampler * self, GstPerfSample * sample)
+{
+  guint64 idle = 0;
+  guint64 total = 0;
+  host_cpu_load_info_data_t cpuinfo = { 0 };
+  mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+
+  if (host_statistics (mach_host_self (), HOST_CPU_LOAD_INFO,
+          (host_info_t) & cpuinfo, &count) != KERN_SUCCESS) {
+    GST_ERROR ("Failed to get the CPU load");
+    return;
+  }
+
+  for (int i = 0; i < CPU_STATE_MAX; i++) {
+    total += cpuinfo.cpu_ticks[i];
+  }
+  idle = cpuinfo.cpu_ticks[CPU_STATE_IDLE];
+
+  sample->cpu_load = gst_perf_compute_cpu (&self->prev_cpu_idle,
+      &self->prev_cpu_total, idle, total);
+}
+
+static void
+gst_perf_sampler_read_memory (GstPerfSampler * self, GstPerfSample * sample)
+{
+  /* Not implemented on this OS, the fields stay unknown */
+}
+
+#else /* Unknown OS */
+static void
+gst_perf_sampler_read_cpu (GstPerfSampler * self, GstPerfSample * sample)
+{
+  /* Not really an error, we just don't know how to measure CPU on this OS */
+}
+
+static void
+gst_perf_sampler_read_memory (GstPerfSampler * self, GstPerfSample * sample)
+{
+}
+#endif
+
+static GstPerfSample *
+gst_perf_sample_new (void)
+{
+  GstPerfSample *sample;
+
+  sample = g_new0 (GstPerfSample, 1);
+  sample->refcount = 1;
+  sample->timestamp = gst_util_get_timestamp ();
+  sample->cpu_load = -1;
+
+  return sample;
+}
+
+static void
+gst_perf_sampler_publish (GstPerfSampler * self, GstPerfSample * sample)
+{
+  GstPerfSample *old;
+
+  /* Readers holding the previous sample keep it alive */
+  g_mutex_lock (&self->lock);
+  old = self->sample;
+  self->sample = sample;
+  g_mutex_unlock (&self->lock);
+
+  if (old) {
+    gst_perf_sample_unref (old);
+  }
+}
+
+static void
+gst_perf_sampler_update (GstPerfSampler * self)
+{
+  GstPerfSample *sample = gst_perf_sample_new ();
+
+  gst_perf_sampler_read_cpu (self, sample);
+  gst_perf_sampler_read_memory (self, sample);
+
+  gst_perf_sampler_publish (self, sample);
+}
+
+/*
+ * The first CPU reading only seeds the previous counters, against zero it
+ * would be the average load since boot. The loads stay unknown until the
+ * first tick, the memory is known right away.
+ */
+static void
+gst_perf_sampler_seed (GstPerfSampler * self)
+{
+  GstPerfSample *seed = gst_perf_sample_new ();
+  GstPerfSample *sample = gst_perf_sample_new ();
+
+  gst_perf_sampler_read_cpu (self, seed);
+  gst_perf_sample_unref (seed);
+
+  gst_perf_sampler_read_memory (self, sample);
+
+  gst_perf_sampler_publish (self, sample);
+}
+
+static void
+gst_perf_sampler_tick (gpointer user_data, GstClockTime elapsed)
+{
+  gst_perf_sampler_update ((GstPerfSampler *) user_data);
+}
+
+static void
+gst_perf_sampler_free (GstPerfSampler * self)
+{
+  if (self->ticker) {
+    gst_perf_ticker_free (self->ticker);
+  }
+
+#ifdef IS_LINUX
+  if (self->stat) {
+    gst_perf_proc_file_close (self->stat);
+  }
+  if (self->meminfo) {
+    gst_perf_proc_file_close (self->meminfo);
+  }
+  if (self->statm) {
+    gst_perf_proc_file_close (self->statm);
+  }
+#endif
+
+  if (self->sample) {
+    gst_perf_sample_unref (self->sample);
+  }
+
+  g_free (self->prev_core_total);
+  g_free (self->prev_core_idle);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+static GstPerfSampler *
+gst_perf_sampler_new (void)
+{
+  GstPerfSampler *self;
+
+  self = g_new0 (GstPerfSampler, 1);
+  g_mutex_init (&self->lock);
+
+#ifdef IS_LINUX
+  /* A missing file only leaves its metrics unknown */
+  self->stat = gst_perf_proc_file_open ("/proc/stat");
+  self->meminfo = gst_perf_proc_file_open ("/proc/meminfo");
+  self->statm = gst_perf_proc_file_open ("/proc/self/statm");
+  self->page_size = sysconf (_SC_PAGESIZE);
+#endif
+
+  /* Publish right away so new users never see nothing */
+  gst_perf_sampler_seed (self);
+
+  self->ticker = gst_perf_ticker_new ("perf-sampler",
+      GST_PERF_SAMPLER_INTERVAL, gst_perf_sampler_tick, self);
+  if (NULL == self->ticker) {
+    gst_perf_sampler_free (self);
+    return NULL;
+  }
+
+  return self;
+}
+
+/*
+ * Returns the sampler shared by every perf instance in the process,
+ * starting it for the first user. Returns NULL if it could not be started.
+ */
+GstPerfSampler *
+gst_perf_sampler_acquire (void)
+{
+  GstPerfSampler *self;
+
+  g_mutex_lock (&sampler_lock);
+
+  if (0 == sampler_users) {
+    sampler = gst_perf_sampler_new ();
+  }
+
+  if (sampler) {
+    sampler_users++;
+  }
+  self = sampler;
+
+  g_mutex_unlock (&sampler_lock);
+
+  return self;
+}
+
+/* Drops a user, the last one stops the sampler */
+void
+gst_perf_sampler_release (GstPerfSampler * self)
+{
+  g_return_if_fail (self);
+
+  g_mutex_lock (&sampler_lock);
+
+  g_warn_if_fail (self == sampler);
+
+  sampler_users--;
+  if (0 == sampler_users) {
+    gst_perf_sampler_free (sampler);
+    sampler = NULL;
+  }
+
+  g_mutex_unlock (&sampler_lock);
+}
+
+/* Returns a reference to the latest sample, unref it when done */
+GstPerfSample *
+gst_perf_sampler_get_sample (GstPerfSampler * self)
+{
+  GstPerfSample *sample;
+
+  g_return_val_if_fail (self, NULL);
+
+  g_mutex_lock (&self->lock);
+  sample = gst_perf_sample_ref (self->sample);
+  g_mutex_unlock (&self->lock);
+
+  return sample;
+}
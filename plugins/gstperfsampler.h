@@ -0,0 +1,69 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_SAMPLER_H_
+#define _GST_PERF_SAMPLER_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPerfSampler GstPerfSampler;
+typedef struct _GstPerfSample GstPerfSample;
+
+/**
+ * GstPerfSample:
+ * @timestamp: when the sample was taken
+ * @cpu_load: system wide CPU load in percent, -1 if unknown
+ * @n_cores: the number of entries in @core_load
+ * @core_load: the load of every core in percent, indexed by core number
+ * @mem_total: the system memory in bytes, 0 if unknown
+ * @mem_available: the memory available to new work in bytes, 0 if unknown
+ * @rss: the resident memory of the process in bytes, 0 if unknown
+ *
+ * A snapshot of the system and process taken once per sampler tick. It is
+ * never modified after being published, so every perf instance that looks
+ * at the same tick sees the same numbers.
+ */
+struct _GstPerfSample
+{
+  /*< private > */
+  gint refcount;
+
+  /*< public > */
+  GstClockTime timestamp;
+
+  gint cpu_load;
+  guint n_cores;
+  gint *core_load;
+
+  guint64 mem_total;
+  guint64 mem_available;
+  guint64 rss;
+};
+
+GstPerfSample *gst_perf_sample_ref (GstPerfSample * sample);
+void gst_perf_sample_unref (GstPerfSample * sample);
+
+GstPerfSampler *gst_perf_sampler_acquire (void);
+void gst_perf_sampler_release (GstPerfSampler * sampler);
+GstPerfSample *gst_perf_sampler_get_sample (GstPerfSampler * sampler);
+
+G_END_DECLS
+#endif
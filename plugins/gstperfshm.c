@@ -0,0 +1,237 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfshm.h"
+#include "gstperfatomic.h"
+
+#include <gst/gst.h>
+#include <string.h>
+
+#ifdef HAVE_SHM_OPEN
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+GST_DEBUG_CATEGORY_EXTERN (gst_perf_debug);
+#define GST_CAT_DEFAULT gst_perf_debug
+
+#define GST_PERF_SHM_SIZE(n_slots) \
+  (sizeof (GstPerfShmHeader) + (gsize) (n_slots) * sizeof (GstPerfShmSlot))
+
+/* The segment of the process and its slots in use, protected by shm_lock */
+static GMutex shm_lock;
+static GstPerfShmHeader *shm_header = NULL;
+static gchar *shm_name = NULL;
+static guint shm_n_slots = 0;
+static guint shm_users = 0;
+
+#ifdef HAVE_SHM_OPEN
+/* The segment can't grow once instances write into it, so its size is
+ * taken from the environment when it is created */
+static guint
+gst_perf_shm_get_n_slots (void)
+{
+  const gchar *env;
+  guint64 n_slots;
+  gchar *end = NULL;
+
+  env = g_getenv (GST_PERF_SHM_SLOTS_ENV);
+  if (NULL == env) {
+    return GST_PERF_SHM_DEFAULT_SLOTS;
+  }
+
+  n_slots = g_ascii_strtoull (env, &end, 10);
+  if (end == env || *end != '\0' || 0 == n_slots
+      || n_slots > GST_PERF_SHM_MAX_SLOTS) {
+    GST_WARNING ("Invalid %s \"%s\", expected 1 to %d, using %d",
+        GST_PERF_SHM_SLOTS_ENV, env, GST_PERF_SHM_MAX_SLOTS,
+        GST_PERF_SHM_DEFAULT_SLOTS);
+    return GST_PERF_SHM_DEFAULT_SLOTS;
+  }
+
+  return n_slots;
+}
+
+static GstPerfShmHeader *
+gst_perf_shm_open (void)
+{
+  GstPerfShmHeader *header;
+  gint fd;
+
+  shm_n_slots = gst_perf_shm_get_n_slots ();
+  shm_name = g_strdup_printf (GST_PERF_SHM_NAME_FORMAT, (gint) getpid ());
+
+  /* Anything already there is left by an earlier process with our pid */
+  shm_unlink (shm_name);
+
+  fd = shm_open (shm_name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    GST_WARNING ("Unable to create %s: %s", shm_name, g_strerror (errno));
+    goto error;
+  }
+
+  if (0 != ftruncate (fd, GST_PERF_SHM_SIZE (shm_n_slots))) {
+    GST_WARNING ("Unable to size %s: %s", shm_name, g_strerror (errno));
+    close (fd);
+    shm_unlink (shm_name);
+    goto error;
+  }
+
+  header = mmap (NULL, GST_PERF_SHM_SIZE (shm_n_slots),
+      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (MAP_FAILED == header) {
+    GST_WARNING ("Unable to map %s: %s", shm_name, g_strerror (errno));
+    shm_unlink (shm_name);
+    goto error;
+  }
+
+  /* Fresh pages are zeroed, readers wait for the magic */
+  header->version = GST_PERF_SHM_VERSION;
+  header->slot_size = sizeof (GstPerfShmSlot);
+  header->n_slots = shm_n_slots;
+  header->pid = getpid ();
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  memcpy (header->magic, GST_PERF_SHM_MAGIC, sizeof (header->magic));
+
+  GST_INFO ("Exporting statistics in %s, %u slots", shm_name, shm_n_slots);
+
+  return header;
+
+error:
+  g_free (shm_name);
+  shm_name = NULL;
+  return NULL;
+}
+
+static void
+gst_perf_shm_close (void)
+{
+  munmap (shm_header, GST_PERF_SHM_SIZE (shm_n_slots));
+  shm_unlink (shm_name);
+  g_free (shm_name);
+  shm_name = NULL;
+}
+#else
+static GstPerfShmHeader *
+gst_perf_shm_open (void)
+{
+  GST_WARNING ("Shared memory is not supported on this platform");
+  return NULL;
+}
+
+static void
+gst_perf_shm_close (void)
+{
+}
+#endif
+
+static GstPerfShmSlot *
+gst_perf_shm_get_slots (GstPerfShmHeader * header)
+{
+  return (GstPerfShmSlot *) ((gchar *) header + sizeof (GstPerfShmHeader));
+}
+
+/**
+ * gst_perf_shm_slot_acquire:
+ * @name: the name to publish with, truncated to fit the slot
+ *
+ * Claims a free slot of the segment of the process, creating the segment
+ * for the first slot. Write the slot under its sequence with
+ * gst_perf_seqlock_write_begin() and gst_perf_seqlock_write_end().
+ *
+ * Returns: the slot, or %NULL if the segment couldn't be created or all
+ * of its slots are in use.
+ */
+GstPerfShmSlot *
+gst_perf_shm_slot_acquire (const gchar * name)
+{
+  GstPerfShmSlot *slots, *slot = NULL;
+  guint i;
+
+  g_return_val_if_fail (name, NULL);
+
+  g_mutex_lock (&shm_lock);
+
+  if (0 == shm_users) {
+    shm_header = gst_perf_shm_open ();
+  }
+
+  if (NULL == shm_header) {
+    goto out;
+  }
+
+  slots = gst_perf_shm_get_slots (shm_header);
+  for (i = 0; i < shm_n_slots; i++) {
+    if (!slots[i].in_use) {
+      slot = &slots[i];
+      break;
+    }
+  }
+
+  if (NULL == slot) {
+    GST_WARNING ("All %u shared memory slots are in use, set %s to raise "
+        "the limit", shm_n_slots, GST_PERF_SHM_SLOTS_ENV);
+    if (0 == shm_users) {
+      gst_perf_shm_close ();
+      shm_header = NULL;
+    }
+    goto out;
+  }
+
+  gst_perf_seqlock_write_begin (&slot->sequence);
+  memset ((gchar *) slot + G_STRUCT_OFFSET (GstPerfShmSlot, fields), 0,
+      sizeof (GstPerfShmSlot) - G_STRUCT_OFFSET (GstPerfShmSlot, fields));
+  g_strlcpy (slot->name, name, sizeof (slot->name));
+  slot->in_use = TRUE;
+  gst_perf_seqlock_write_end (&slot->sequence);
+
+  shm_users++;
+
+out:
+  g_mutex_unlock (&shm_lock);
+
+  return slot;
+}
+
+void
+gst_perf_shm_slot_release (GstPerfShmSlot * slot)
+{
+  g_return_if_fail (slot);
+
+  g_mutex_lock (&shm_lock);
+
+  gst_perf_seqlock_write_begin (&slot->sequence);
+  slot->in_use = FALSE;
+  gst_perf_seqlock_write_end (&slot->sequence);
+
+  shm_users--;
+  if (0 == shm_users) {
+    gst_perf_shm_close ();
+    shm_header = NULL;
+  }
+
+  g_mutex_unlock (&shm_lock);
+}
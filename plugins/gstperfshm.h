@@ -0,0 +1,116 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_SHM_H_
+#define _GST_PERF_SHM_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Layout of the shared memory segment every perf instance of a process
+ * publishes into, /dev/shm/gst-perf-<pid>. It only depends on GLib types
+ * so monitoring tools can include this header as is. Everything is in
+ * host byte order.
+ */
+#define GST_PERF_SHM_NAME_FORMAT "/gst-perf-%d"
+#define GST_PERF_SHM_MAGIC "GSTPERFS"
+#define GST_PERF_SHM_VERSION 1
+#define GST_PERF_SHM_DEFAULT_SLOTS 1024
+#define GST_PERF_SHM_MAX_SLOTS 65536
+/* Environment variable overriding the number of slots of the segment */
+#define GST_PERF_SHM_SLOTS_ENV "GST_PERF_SHM_SLOTS"
+#define GST_PERF_SHM_NAME_SIZE 128
+
+/* Which of the optional GstPerfShmSlot values are set */
+typedef enum
+{
+  GST_PERF_SHM_HAS_CPU_LOAD = (1 << 0),
+  GST_PERF_SHM_HAS_THREAD_CPU = (1 << 1),
+  GST_PERF_SHM_HAS_GAP = (1 << 2),
+  GST_PERF_SHM_HAS_LATENCY = (1 << 3),
+  GST_PERF_SHM_HAS_BACKPRESSURE = (1 << 4),
+  GST_PERF_SHM_HAS_MEDIA_TIME = (1 << 5),
+  GST_PERF_SHM_HAS_LAST_BUFFER = (1 << 6)
+} GstPerfShmFields;
+
+/**
+ * GstPerfShmSlot:
+ * @sequence: seqlock, odd while the slot is written. Copy the slot, then
+ *   retry if the sequence was odd or changed meanwhile
+ * @in_use: whether a perf instance owns the slot
+ * @fields: the #GstPerfShmFields that are set
+ * @name: path of the perf instance, NUL terminated
+ * @reports: number of reports published so far
+ * @timestamp: when the last report was made, gst_util_get_timestamp()
+ * @last_arrival: when the last buffer arrived, on the same clock
+ * @stall_timeout: the stall-timeout of the instance, 0 if disabled
+ *
+ * The latest report of a perf instance, rates per second, CPU loads in
+ * percent and times in nanoseconds.
+ */
+typedef struct _GstPerfShmSlot
+{
+  guint32 sequence;
+  guint32 in_use;
+  guint32 fields;
+  guint32 reserved;
+  gchar name[GST_PERF_SHM_NAME_SIZE];
+  guint64 reports;
+  guint64 timestamp;
+  gdouble fps;
+  gdouble mean_fps;
+  gdouble bps;
+  gdouble mean_bps;
+  gdouble cpu_load;
+  gdouble thread_cpu;
+  gdouble process_cpu;
+  guint64 gap_p50;
+  guint64 gap_p99;
+  guint64 latency_p50;
+  guint64 latency_p99;
+  gdouble backpressure;
+  gdouble realtime_factor;
+  guint64 last_arrival;
+  guint64 stall_timeout;
+} GstPerfShmSlot;
+
+/**
+ * GstPerfShmHeader:
+ * @magic: GST_PERF_SHM_MAGIC, not NUL terminated, written last
+ * @version: GST_PERF_SHM_VERSION
+ * @slot_size: size of a #GstPerfShmSlot
+ * @n_slots: number of slots following the header
+ * @pid: the process publishing
+ */
+typedef struct _GstPerfShmHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 slot_size;
+  guint32 n_slots;
+  guint32 pid;
+} GstPerfShmHeader;
+
+GstPerfShmSlot *gst_perf_shm_slot_acquire (const gchar * name);
+void gst_perf_shm_slot_release (GstPerfShmSlot * slot);
+
+G_END_DECLS
+#endif
@@ -0,0 +1,514 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:tracer-perftracer
+ *
+ * The perftracer hooks every buffer and buffer list pushed on any pad of
+ * the process and logs the framerate and bitrate of each link, without
+ * having to add perf elements to the pipelines:
+ *
+ * |[
+ * GST_TRACERS="perftracer" GST_DEBUG="GST_TRACER:7" gst-launch-1.0 ...
+ * GST_TRACERS="perftracer(interval=500,window-size=10)" ...
+ * ]|
+ *
+ * The element is already registered as "perf", and the registry holds a
+ * single feature per name, so the tracer is registered as "perftracer".
+ *
+ * Each pushing thread accumulates into its own counters, so the hot path
+ * never takes a lock once a thread has seen a pad. The counters of a thread
+ * that exited are folded into its link on the next report.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperftracer.h"
+
+#if GST_CHECK_VERSION(1,8,0)
+
+#include "gstperfatomic.h"
+#include "gstperfutils.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_perf_tracer_debug);
+#define GST_CAT_DEFAULT gst_perf_tracer_debug
+
+#define DEFAULT_INTERVAL 1000
+#define DEFAULT_WINDOW_SIZE 0
+
+#define GST_PERF_TRACER_BITS_PER_BYTE 8
+
+/*
+ * Counters owned by a single pushing thread for a single pad. dead is set
+ * when the link goes away, orphaned when the thread does.
+ */
+typedef struct _GstPerfTracerSlot
+{
+  gint refcount;
+  gint dead;
+  gint orphaned;
+  guint64 frames;
+  guint64 bytes;
+} GstPerfTracerSlot;
+
+/* Key of the per thread slots, several tracers may watch the same pad */
+typedef struct _GstPerfTracerKey
+{
+  GstPerfTracer *tracer;
+  GstPad *pad;
+} GstPerfTracerKey;
+
+/* Aggregated statistics of a src pad, protected by the tracer lock */
+typedef struct _GstPerfTracerLink
+{
+  gchar *name;
+  GSList *slots;
+
+  /* Everything counted by the threads that exited */
+  guint64 retired_frames;
+  guint64 retired_bytes;
+
+  guint64 last_frames;
+  guint64 last_bytes;
+
+  guint64 count;
+  gdouble mean_fps;
+  gdouble mean_bps;
+  gdouble *fps_window;
+  gdouble *bps_window;
+} GstPerfTracerLink;
+
+struct _GstPerfTracer
+{
+  GstTracer parent;
+
+  GMutex lock;
+  /* GstPad * -> GstPerfTracerLink * */
+  GHashTable *links;
+  GstPerfTicker *ticker;
+
+  guint interval;
+  guint window_size;
+};
+
+struct _GstPerfTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+#define gst_perf_tracer_parent_class parent_class
+G_DEFINE_TYPE (GstPerfTracer, gst_perf_tracer, GST_TYPE_TRACER);
+
+static GstTracerRecord *tr_link;
+
+static void gst_perf_tracer_slot_unref (GstPerfTracerSlot * slot);
+
+/* Per thread GstPerfTracerKey * -> GstPerfTracerSlot * */
+static GPrivate thread_slots =
+G_PRIVATE_INIT ((GDestroyNotify) g_hash_table_unref);
+
+static GstPerfTracerSlot *
+gst_perf_tracer_slot_new (void)
+{
+  GstPerfTracerSlot *slot = g_new0 (GstPerfTracerSlot, 1);
+
+  slot->refcount = 1;
+
+  return slot;
+}
+
+static GstPerfTracerSlot *
+gst_perf_tracer_slot_ref (GstPerfTracerSlot * slot)
+{
+  g_atomic_int_inc (&slot->refcount);
+
+  return slot;
+}
+
+static void
+gst_perf_tracer_slot_unref (GstPerfTracerSlot * slot)
+{
+  if (g_atomic_int_dec_and_test (&slot->refcount)) {
+    g_free (slot);
+  }
+}
+
+/* Drops the reference of the thread, which won't count into it anymore */
+static void
+gst_perf_tracer_slot_release (GstPerfTracerSlot * slot)
+{
+  g_atomic_int_set (&slot->orphaned, TRUE);
+  gst_perf_tracer_slot_unref (slot);
+}
+
+static guint
+gst_perf_tracer_key_hash (gconstpointer data)
+{
+  const GstPerfTracerKey *key = data;
+
+  return g_direct_hash (key->tracer) * 31 + g_direct_hash (key->pad);
+}
+
+static gboolean
+gst_perf_tracer_key_equal (gconstpointer a, gconstpointer b)
+{
+  const GstPerfTracerKey *key_a = a;
+  const GstPerfTracerKey *key_b = b;
+
+  return key_a->tracer == key_b->tracer && key_a->pad == key_b->pad;
+}
+
+static GstPerfTracerLink *
+gst_perf_tracer_link_new (GstPad * pad, guint window_size)
+{
+  GstPerfTracerLink *link = g_new0 (GstPerfTracerLink, 1);
+
+  link->name = g_strdup_printf ("%s:%s", GST_DEBUG_PAD_NAME (pad));
+
+  if (window_size) {
+    link->fps_window = g_new0 (gdouble, window_size);
+    link->bps_window = g_new0 (gdouble, window_size);
+  }
+
+  return link;
+}
+
+static void
+gst_perf_tracer_link_free (GstPerfTracerLink * link)
+{
+  GSList *walk;
+
+  /* Threads still holding the slots will replace them on their next push */
+  for (walk = link->slots; walk; walk = walk->next) {
+    GstPerfTracerSlot *slot = walk->data;
+
+    g_atomic_int_set (&slot->dead, TRUE);
+    gst_perf_tracer_slot_unref (slot);
+  }
+
+  g_slist_free (link->slots);
+  g_free (link->fps_window);
+  g_free (link->bps_window);
+  g_free (link->name);
+  g_free (link);
+}
+
+static void
+gst_perf_tracer_pad_finalized (gpointer data, GObject * pad)
+{
+  GstPerfTracer *self = GST_PERF_TRACER (data);
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_remove (self->links, pad);
+  g_mutex_unlock (&self->lock);
+}
+
+static GstPerfTracerSlot *
+gst_perf_tracer_get_slot (GstPerfTracer * self, GstPad * pad)
+{
+  GstPerfTracerKey key = { self, pad };
+  GstPerfTracerKey *copy;
+  GHashTable *slots;
+  GstPerfTracerSlot *slot = NULL;
+  GstPerfTracerLink *link;
+
+  slots = g_private_get (&thread_slots);
+  if (G_UNLIKELY (!slots)) {
+    slots = g_hash_table_new_full (gst_perf_tracer_key_hash,
+        gst_perf_tracer_key_equal, g_free,
+        (GDestroyNotify) gst_perf_tracer_slot_release);
+    g_private_set (&thread_slots, slots);
+  } else {
+    slot = g_hash_table_lookup (slots, &key);
+  }
+
+  if (G_LIKELY (slot && !g_atomic_int_get (&slot->dead))) {
+    return slot;
+  }
+
+  /* First push on this pad from this thread, register a new slot */
+  slot = gst_perf_tracer_slot_new ();
+
+  g_mutex_lock (&self->lock);
+  link = g_hash_table_lookup (self->links, pad);
+  if (!link) {
+    link = gst_perf_tracer_link_new (pad, self->window_size);
+    g_hash_table_insert (self->links, pad, link);
+    g_object_weak_ref (G_OBJECT (pad), gst_perf_tracer_pad_finalized, self);
+  }
+  link->slots = g_slist_prepend (link->slots, gst_perf_tracer_slot_ref (slot));
+  g_mutex_unlock (&self->lock);
+
+  /* Lookups use the key on the stack, the table owns a copy */
+  copy = g_new (GstPerfTracerKey, 1);
+  *copy = key;
+  g_hash_table_replace (slots, copy, slot);
+
+  return slot;
+}
+
+static gboolean
+gst_perf_tracer_add_buffer_size (GstBuffer ** buffer, guint idx,
+    gpointer user_data)
+{
+  guint64 *bytes = user_data;
+
+  *bytes += gst_buffer_get_size (*buffer);
+
+  return TRUE;
+}
+
+static void
+gst_perf_tracer_push_pre (GObject * object, GstClockTime ts, GstPad * pad,
+    GstBuffer * buffer)
+{
+  GstPerfTracerSlot *slot;
+
+  slot = gst_perf_tracer_get_slot (GST_PERF_TRACER (object), pad);
+
+  gst_perf_atomic_u64_add (&slot->frames, 1);
+  gst_perf_atomic_u64_add (&slot->bytes, gst_buffer_get_size (buffer));
+}
+
+static void
+gst_perf_tracer_push_list_pre (GObject * object, GstClockTime ts,
+    GstPad * pad, GstBufferList * list)
+{
+  GstPerfTracerSlot *slot;
+  guint64 bytes = 0;
+
+  slot = gst_perf_tracer_get_slot (GST_PERF_TRACER (object), pad);
+
+  gst_buffer_list_foreach (list, gst_perf_tracer_add_buffer_size, &bytes);
+
+  gst_perf_atomic_u64_add (&slot->frames, gst_buffer_list_length (list));
+  gst_perf_atomic_u64_add (&slot->bytes, bytes);
+}
+
+static gdouble
+gst_perf_tracer_update_mean (GstPerfTracer * self, GstPerfTracerLink * link,
+    gdouble * window, gdouble mean, gdouble sample)
+{
+  guint idx;
+
+  if (!self->window_size) {
+    return gst_perf_update_average (link->count, sample, mean);
+  }
+
+  /* Same circular buffer scheme as the perf element bitrate */
+  idx = (link->count - 1) % self->window_size;
+  mean = gst_perf_update_moving_average (self->window_size, mean, sample,
+      window[idx]);
+  window[idx] = sample;
+
+  return mean;
+}
+
+static void
+gst_perf_tracer_tick (gpointer data, GstClockTime elapsed)
+{
+  GstPerfTracer *self = GST_PERF_TRACER (data);
+  GHashTableIter iter;
+  gpointer value;
+  gdouble seconds = 1.0 * elapsed / GST_SECOND;
+
+  g_mutex_lock (&self->lock);
+
+  g_hash_table_iter_init (&iter, self->links);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    GstPerfTracerLink *link = value;
+    guint64 frames, bytes;
+    gdouble fps, bps;
+    GSList *walk, *next;
+
+    frames = link->retired_frames;
+    bytes = link->retired_bytes;
+
+    for (walk = link->slots; walk; walk = next) {
+      GstPerfTracerSlot *slot = walk->data;
+      /* Checked first, the counters of an orphaned slot are final */
+      gboolean orphaned = g_atomic_int_get (&slot->orphaned);
+      guint64 slot_frames = gst_perf_atomic_u64_get (&slot->frames);
+      guint64 slot_bytes = gst_perf_atomic_u64_get (&slot->bytes);
+
+      next = walk->next;
+      frames += slot_frames;
+      bytes += slot_bytes;
+
+      if (orphaned) {
+        link->retired_frames += slot_frames;
+        link->retired_bytes += slot_bytes;
+        link->slots = g_slist_delete_link (link->slots, walk);
+        gst_perf_tracer_slot_unref (slot);
+      }
+    }
+
+    fps = (frames - link->last_frames) / seconds;
+    bps = (bytes - link->last_bytes) * GST_PERF_TRACER_BITS_PER_BYTE / seconds;
+    link->last_frames = frames;
+    link->last_bytes = bytes;
+
+    link->count++;
+    link->mean_fps = gst_perf_tracer_update_mean (self, link, link->fps_window,
+        link->mean_fps, fps);
+    link->mean_bps = gst_perf_tracer_update_mean (self, link, link->bps_window,
+        link->mean_bps, bps);
+
+    gst_tracer_record_log (tr_link, link->name, fps, link->mean_fps, bps,
+        link->mean_bps);
+  }
+
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+gst_perf_tracer_parse_params (GstPerfTracer * self)
+{
+  GstStructure *params_struct;
+  gchar *params, *tmp;
+  guint value;
+
+  g_object_get (self, "params", &params, NULL);
+  if (!params) {
+    return;
+  }
+
+  tmp = g_strdup_printf ("perftracer,%s", params);
+  params_struct = gst_structure_from_string (tmp, NULL);
+  g_free (tmp);
+
+  if (!params_struct) {
+    GST_WARNING_OBJECT (self, "Invalid parameters: %s", params);
+    g_free (params);
+    return;
+  }
+
+  if (gst_structure_get_uint (params_struct, "interval", &value) ||
+      gst_structure_get_int (params_struct, "interval", (gint *) & value)) {
+    self->interval = value;
+  }
+
+  if (gst_structure_get_uint (params_struct, "window-size", &value) ||
+      gst_structure_get_int (params_struct, "window-size", (gint *) & value)) {
+    self->window_size = value;
+  }
+
+  gst_structure_free (params_struct);
+  g_free (params);
+}
+
+static void
+gst_perf_tracer_constructed (GObject * object)
+{
+  GstPerfTracer *self = GST_PERF_TRACER (object);
+
+  gst_perf_tracer_parse_params (self);
+
+  if (!self->interval) {
+    GST_WARNING_OBJECT (self, "Interval is 0, using %d ms", DEFAULT_INTERVAL);
+    self->interval = DEFAULT_INTERVAL;
+  }
+
+  self->ticker = gst_perf_ticker_new ("perftracer", self->interval,
+      gst_perf_tracer_tick, self);
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gst_perf_tracer_forget_pad (gpointer key, gpointer value, gpointer user_data)
+{
+  g_object_weak_unref (G_OBJECT (key), gst_perf_tracer_pad_finalized,
+      user_data);
+}
+
+static void
+gst_perf_tracer_finalize (GObject * object)
+{
+  GstPerfTracer *self = GST_PERF_TRACER (object);
+
+  if (self->ticker) {
+    gst_perf_ticker_free (self->ticker);
+  }
+
+  g_hash_table_foreach (self->links, gst_perf_tracer_forget_pad, self);
+  g_hash_table_unref (self->links);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_perf_tracer_class_init (GstPerfTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_perf_tracer_constructed;
+  gobject_class->finalize = gst_perf_tracer_finalize;
+
+  GST_DEBUG_CATEGORY_INIT (gst_perf_tracer_debug, "perftracer", 0,
+      "Debug category for perf tracer");
+
+  tr_link = gst_tracer_record_new ("perf-link.class",
+      "pad", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_PAD, NULL),
+      "fps", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_DOUBLE,
+          "description", G_TYPE_STRING, "Frames per second in the interval",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_NONE, NULL),
+      "mean-fps", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_DOUBLE,
+          "description", G_TYPE_STRING, "Average frames per second",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL),
+      "bps", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_DOUBLE,
+          "description", G_TYPE_STRING, "Bits per second in the interval",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_NONE, NULL),
+      "mean-bps", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_DOUBLE,
+          "description", G_TYPE_STRING, "Average bits per second",
+          "flags", GST_TYPE_TRACER_VALUE_FLAGS,
+          GST_TRACER_VALUE_FLAGS_AGGREGATED, NULL), NULL);
+}
+
+static void
+gst_perf_tracer_init (GstPerfTracer * self)
+{
+  GstTracer *tracer = GST_TRACER (self);
+
+  self->interval = DEFAULT_INTERVAL;
+  self->window_size = DEFAULT_WINDOW_SIZE;
+
+  g_mutex_init (&self->lock);
+  self->links = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) gst_perf_tracer_link_free);
+
+  gst_tracing_register_hook (tracer, "pad-push-pre",
+      G_CALLBACK (gst_perf_tracer_push_pre));
+  gst_tracing_register_hook (tracer, "pad-push-list-pre",
+      G_CALLBACK (gst_perf_tracer_push_list_pre));
+}
+
+#endif
@@ -0,0 +1,266 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfutils.h"
+
+#include <math.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_EXTERN (gst_perf_debug);
+#define GST_CAT_DEFAULT gst_perf_debug
+
+struct _GstPerfTicker
+{
+  GThread *thread;
+  GstClock *clock;
+  GstClockID clock_id;
+  GstClockTime interval;
+  GstClockTime last;
+
+  GstPerfTickerFunc func;
+  gpointer user_data;
+};
+
+static gpointer gst_perf_ticker_thread (gpointer data);
+
+gdouble
+gst_perf_update_average (guint64 count, gdouble current, gdouble old)
+{
+  gdouble ret = 0;
+
+  if (count != 0) {
+    ret = ((count - 1) * old + current) / count;
+  }
+
+  return ret;
+}
+
+gdouble
+gst_perf_update_moving_average (guint64 window_size, gdouble old_average,
+    gdouble new_sample, gdouble old_sample)
+{
+  gdouble ret = 0;
+
+  if (window_size != 0) {
+    ret = (old_average * window_size - old_sample + new_sample) / window_size;
+  }
+
+  return ret;
+}
+
+static const GstClockTime gst_perf_ewma_time_constants[] = {
+  1 * GST_SECOND, 10 * GST_SECOND, 60 * GST_SECOND
+};
+
+static const gchar *gst_perf_ewma_names[] = { "1s", "10s", "60s" };
+
+G_STATIC_ASSERT (G_N_ELEMENTS (gst_perf_ewma_time_constants) ==
+    GST_PERF_EWMA_HORIZONS);
+
+void
+gst_perf_ewma_reset (GstPerfEwma * ewma)
+{
+  g_return_if_fail (ewma);
+
+  memset (ewma, 0, sizeof (*ewma));
+}
+
+void
+gst_perf_ewma_update (GstPerfEwma * ewma, gdouble sample,
+    GstClockTime elapsed)
+{
+  gdouble alpha;
+  guint i;
+
+  g_return_if_fail (ewma);
+
+  /* Seed with the first sample instead of ramping up from zero */
+  if (!ewma->started) {
+    for (i = 0; i < GST_PERF_EWMA_HORIZONS; i++) {
+      ewma->average[i] = sample;
+    }
+    ewma->started = TRUE;
+    return;
+  }
+
+  for (i = 0; i < GST_PERF_EWMA_HORIZONS; i++) {
+    alpha = 1.0 - exp (-1.0 * elapsed / gst_perf_ewma_time_constants[i]);
+    ewma->average[i] += alpha * (sample - ewma->average[i]);
+  }
+}
+
+const gchar *
+gst_perf_ewma_horizon_name (guint horizon)
+{
+  g_return_val_if_fail (horizon < GST_PERF_EWMA_HORIZONS, NULL);
+
+  return gst_perf_ewma_names[horizon];
+}
+
+static gpointer
+gst_perf_ticker_thread (gpointer data)
+{
+  GstPerfTicker *ticker = data;
+  GstClockTime now;
+  GstClockTimeDiff jitter;
+  GstClockReturn ret;
+
+  while (TRUE) {
+    ret = gst_clock_id_wait (ticker->clock_id, &jitter);
+    if (GST_CLOCK_UNSCHEDULED == ret) {
+      break;
+    }
+
+    /*
+     * The periodic id is scheduled on absolute times, so it doesn't drift.
+     * If we fell behind by more than a whole interval, skip the missed
+     * ticks and let the next one cover all the elapsed time.
+     */
+    if (GST_CLOCK_EARLY == ret &&
+        jitter > (GstClockTimeDiff) ticker->interval) {
+      GST_DEBUG ("Skipping late tick, jitter %" G_GINT64_FORMAT, jitter);
+      continue;
+    }
+
+    now = gst_clock_get_time (ticker->clock);
+    if (now > ticker->last) {
+      ticker->func (ticker->user_data, now - ticker->last);
+    }
+    ticker->last = now;
+  }
+
+  return NULL;
+}
+
+/**
+ * gst_perf_ticker_new:
+ * @name: name for the ticker thread
+ * @interval_ms: tick interval in milliseconds, must not be 0
+ * @func: function to call on every tick
+ * @user_data: data to pass to @func
+ *
+ * Starts a thread that calls @func every @interval_ms on the system
+ * clock, so no main loop is required.
+ *
+ * Returns: a new ticker, or %NULL if the thread couldn't be created.
+ */
+GstPerfTicker *
+gst_perf_ticker_new (const gchar * name, guint interval_ms,
+    GstPerfTickerFunc func, gpointer user_data)
+{
+  GstPerfTicker *ticker;
+
+  g_return_val_if_fail (name, NULL);
+  g_return_val_if_fail (interval_ms, NULL);
+  g_return_val_if_fail (func, NULL);
+
+  ticker = g_new0 (GstPerfTicker, 1);
+  ticker->func = func;
+  ticker->user_data = user_data;
+  ticker->interval = interval_ms * GST_MSECOND;
+
+  ticker->clock = gst_system_clock_obtain ();
+  ticker->last = gst_clock_get_time (ticker->clock);
+  ticker->clock_id = gst_clock_new_periodic_id (ticker->clock,
+      ticker->last + ticker->interval, ticker->interval);
+
+  ticker->thread = g_thread_try_new (name, gst_perf_ticker_thread, ticker,
+      NULL);
+  if (!ticker->thread) {
+    GST_ERROR ("Unable to create the %s thread", name);
+    gst_perf_ticker_free (ticker);
+    return NULL;
+  }
+
+  return ticker;
+}
+
+/**
+ * gst_perf_ticker_free:
+ * @ticker: the ticker to stop
+ *
+ * Stops the ticker and waits for its thread. Once this returns the tick
+ * function is guaranteed not to be running.
+ */
+void
+gst_perf_ticker_free (GstPerfTicker * ticker)
+{
+  g_return_if_fail (ticker);
+
+  gst_clock_id_unschedule (ticker->clock_id);
+
+  if (ticker->thread) {
+    g_thread_join (ticker->thread);
+  }
+
+  gst_clock_id_unref (ticker->clock_id);
+  gst_object_unref (ticker->clock);
+
+  g_free (ticker);
+}
+
+/* Id of the calling thread, 0 until it asks for one */
+static GPrivate thread_id;
+
+/**
+ * gst_perf_get_thread_id:
+ *
+ * Unlike the #GThread of a thread, whose address can be reused once it
+ * exits, the ids are never given twice.
+ *
+ * Returns: the id of the calling thread, never 0.
+ */
+guint
+gst_perf_get_thread_id (void)
+{
+  static gint last_id = 0;
+  guint id = GPOINTER_TO_UINT (g_private_get (&thread_id));
+
+  if (G_UNLIKELY (0 == id)) {
+    id = (guint) g_atomic_int_add (&last_id, 1) + 1;
+    g_private_set (&thread_id, GUINT_TO_POINTER (id));
+  }
+
+  return id;
+}
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+/**
+ * gst_perf_get_thread_cpu_time:
+ * @clock: the CPU clock of a thread, from pthread_getcpuclockid()
+ *
+ * Returns: the CPU time used by the thread, or %GST_CLOCK_TIME_NONE once
+ * the thread is gone.
+ */
+GstClockTime
+gst_perf_get_thread_cpu_time (clockid_t clock)
+{
+  struct timespec ts;
+
+  if (0 == clock_gettime (clock, &ts)) {
+    return GST_TIMESPEC_TO_TIME (ts);
+  }
+
+  return GST_CLOCK_TIME_NONE;
+}
+#endif
@@ -0,0 +1,82 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_PERF_UTILS_H_
+#define _GST_PERF_UTILS_H_
+
+#include <gst/gst.h>
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+#  include <time.h>
+#endif
+
+G_BEGIN_DECLS
+
+typedef struct _GstPerfTicker GstPerfTicker;
+typedef struct _GstPerfEwma GstPerfEwma;
+
+/* The 1 s, 10 s and 60 s horizons of a GstPerfEwma */
+#define GST_PERF_EWMA_HORIZONS 3
+
+/**
+ * GstPerfEwma:
+ * @average: one exponentially weighted moving average per horizon
+ * @started: whether a first sample seeded the averages
+ *
+ * Load average style averages over several horizons at once. Each update
+ * is O(1) and the weights follow the time that actually elapsed, so
+ * irregular intervals are handled.
+ */
+struct _GstPerfEwma
+{
+  gdouble average[GST_PERF_EWMA_HORIZONS];
+  gboolean started;
+};
+
+/**
+ * GstPerfTickerFunc:
+ * @user_data: the data given to gst_perf_ticker_new()
+ * @elapsed: the clock time that actually elapsed since the previous tick
+ *
+ * Called from the ticker thread once per interval.
+ */
+typedef void (*GstPerfTickerFunc) (gpointer user_data, GstClockTime elapsed);
+
+gdouble gst_perf_update_average (guint64 count, gdouble current,
+    gdouble old);
+gdouble gst_perf_update_moving_average (guint64 window_size,
+    gdouble old_average, gdouble new_sample, gdouble old_sample);
+
+void gst_perf_ewma_reset (GstPerfEwma * ewma);
+void gst_perf_ewma_update (GstPerfEwma * ewma, gdouble sample,
+    GstClockTime elapsed);
+const gchar *gst_perf_ewma_horizon_name (guint horizon);
+
+GstPerfTicker *gst_perf_ticker_new (const gchar * name, guint interval_ms,
+    GstPerfTickerFunc func, gpointer user_data);
+void gst_perf_ticker_free (GstPerfTicker * ticker);
+
+guint gst_perf_get_thread_id (void);
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+GstClockTime gst_perf_get_thread_cpu_time (clockid_t clock);
+#endif
+
+G_END_DECLS
+#endif
@@ -0,0 +1,120 @@
+#!/bin/sh
+# Measures what perf costs per buffer: runs fakesrc ! <element> ! fakesink
+# and the same pipeline without the element, and prints the difference in
+# nanoseconds per buffer. Several plugin directories, for example builds of
+# two revisions, can be given to compare them on the same machine. With -t
+# the element stays in both pipelines and the tracers are measured instead.
+#
+# usage: gst-perf-bench.sh [-n buffers] [-i instances] [-s size] [-r runs]
+#                          [-e element] [-c count] [-t tracers] [plugin-dir ...]
+#
+#  -n  buffers pushed by every source (default 1000000)
+#  -i  parallel branches, each with its own streaming thread (default 1)
+#  -s  size of the buffers in bytes (default 64)
+#  -r  runs of every pipeline, the fastest one counts (default 5)
+#  -e  element under test with its properties (default "perf")
+#  -c  copies of the element chained in every branch (default 1)
+#  -t  GST_TRACERS value to measure, for example "perftracer"
+#
+# Without a plugin directory the installed plugin is measured. Remove any
+# installed copy when comparing build trees, or it may be loaded instead.
+
+buffers=1000000
+instances=1
+size=64
+runs=5
+element=perf
+count=1
+tracers=""
+
+while getopts "n:i:s:r:e:c:t:" opt; do
+  case $opt in
+    n) buffers=$OPTARG ;;
+    i) instances=$OPTARG ;;
+    s) size=$OPTARG ;;
+    r) runs=$OPTARG ;;
+    e) element=$OPTARG ;;
+    c) count=$OPTARG ;;
+    t) tracers=$OPTARG ;;
+    *) sed -n '8,17s/^# \{0,1\}//p' "$0"; exit 1 ;;
+  esac
+done
+shift `expr $OPTIND - 1`
+
+tmpdir=`mktemp -d` || exit 1
+trap 'rm -rf "$tmpdir"' EXIT
+
+# Builds the launch line, with $count copies of $1 between source and sink
+# if given
+pipeline () {
+  chain=""
+  if [ -n "$1" ]; then
+    c=0
+    while [ $c -lt $count ]; do
+      chain="$chain $1 !"
+      c=`expr $c + 1`
+    done
+  fi
+  line=""
+  i=0
+  while [ $i -lt $instances ]; do
+    line="$line fakesrc num-buffers=$buffers sizetype=fixed sizemax=$size"
+    line="$line filltype=nothing !$chain fakesink sync=false async=false"
+    i=`expr $i + 1`
+  done
+  echo "$line"
+}
+
+# Prints the fastest of $runs runs of the pipeline $1 with the tracers $2,
+# in nanoseconds
+measure () {
+  best=""
+  run=0
+  while [ $run -lt $runs ]; do
+    start=`date +%s%N`
+    # shellcheck disable=SC2086
+    GST_TRACERS="$2" gst-launch-1.0 -q $1 > /dev/null || exit 1
+    end=`date +%s%N`
+    elapsed=`expr $end - $start`
+    if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+      best=$elapsed
+    fi
+    run=`expr $run + 1`
+  done
+  echo $best
+}
+
+# Runs the comparison against the plugins found in $1, if any
+bench () {
+  GST_REGISTRY="$tmpdir/registry-`echo "$1" | cksum | cut -d' ' -f1`.bin"
+  export GST_REGISTRY
+  if [ -n "$1" ]; then
+    GST_PLUGIN_PATH="$1"
+    export GST_PLUGIN_PATH
+  fi
+
+  if [ -n "$tracers" ]; then
+    reference=`measure "\`pipeline "$element"\`" ""` || exit 1
+    measured=`measure "\`pipeline "$element"\`" "$tracers"` || exit 1
+    what="$tracers on $count x $element"
+  else
+    reference=`measure "\`pipeline\`" ""` || exit 1
+    measured=`measure "\`pipeline "$element"\`" ""` || exit 1
+    what="$count x $element"
+  fi
+  total=`expr $buffers \* $instances`
+  cost=`expr \( $measured - $reference \) / $total`
+  percent=`awk "BEGIN { printf \"%.2f\", \
+      ($measured - $reference) * 100 / $reference }"`
+
+  echo "${1:-installed}: $what, $cost ns per buffer, $percent%" \
+      "($instances x $buffers buffers of $size bytes)"
+}
+
+if [ $# -eq 0 ]; then
+  bench ""
+fi
+
+for dir in "$@"; do
+  (bench "$dir") || exit 1
+done
@@ -0,0 +1,153 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Compares the procfs reader of the plugin with the stdio parsing it
+ * replaced, reading every cpu line of /proc/stat:
+ *
+ *   gst-perf-procfs-bench [iterations]
+ *
+ * Linux only. Build it with "make -C tools gst-perf-procfs-bench".
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef IS_LINUX
+#error "The procfs reader is only built on Linux"
+#endif
+
+GST_DEBUG_CATEGORY (gst_perf_debug);
+
+/* Built from the plugin source, the plugin exports no API */
+#include "gstperfprocfs.c"
+
+#define DEFAULT_ITERATIONS 100000
+
+/* The cpu lines of /proc/stat are well below this */
+#define BENCH_LINE_MAX_SIZE 256
+#define BENCH_CPU_NAME_MAX_SIZE 16
+#define BENCH_CPU_FIELDS 8
+
+/* What the sampler did before: fopen, fgets and sscanf every time */
+static guint64
+bench_stdio (void)
+{
+  guint32 user, nice, sys, idle, iowait, irq, softirq, steal;
+  gchar line[BENCH_LINE_MAX_SIZE];
+  gchar name[BENCH_CPU_NAME_MAX_SIZE];
+  guint64 sum = 0;
+  FILE *fp;
+
+  fp = fopen ("/proc/stat", "r");
+  if (fp == NULL) {
+    return 0;
+  }
+
+  while (fgets (line, sizeof (line), fp) && g_str_has_prefix (line, "cpu")) {
+    if (9 != sscanf (line, "%15s %u %u %u %u %u %u %u %u", name, &user,
+            &nice, &sys, &idle, &iowait, &irq, &softirq, &steal)) {
+      continue;
+    }
+    sum += user + nice + sys + idle + iowait + irq + softirq + steal;
+  }
+
+  fclose (fp);
+
+  return sum;
+}
+
+/* What the sampler does now: one pread and the inline scanner */
+static guint64
+bench_procfs (GstPerfProcFile * file)
+{
+  const gchar *line, *cursor;
+  guint64 value, sum = 0;
+  guint i;
+
+  line = gst_perf_proc_file_read (file);
+  for (; line && g_str_has_prefix (line, "cpu");
+      line = gst_perf_proc_next_line (line)) {
+    cursor = line + 3;
+    if (g_ascii_isdigit (*cursor)) {
+      cursor = gst_perf_proc_parse_u64 (cursor, &value);
+    }
+
+    for (i = 0; cursor && i < BENCH_CPU_FIELDS; i++) {
+      cursor = gst_perf_proc_parse_u64 (cursor, &value);
+      sum += value;
+    }
+  }
+
+  return sum;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstPerfProcFile *file;
+  gint64 start, stdio_time, procfs_time;
+  guint64 sum = 0;
+  guint iterations = DEFAULT_ITERATIONS;
+  guint i;
+
+  gst_init (&argc, &argv);
+  GST_DEBUG_CATEGORY_INIT (gst_perf_debug, "perf", 0, "perf procfs bench");
+
+  if (argc > 1) {
+    iterations = g_ascii_strtoull (argv[1], NULL, 10);
+  }
+  if (0 == iterations) {
+    g_printerr ("usage: %s [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  file = gst_perf_proc_file_open ("/proc/stat");
+  if (NULL == file) {
+    g_printerr ("Unable to open /proc/stat\n");
+    return EXIT_FAILURE;
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    sum += bench_stdio ();
+  }
+  stdio_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < iterations; i++) {
+    sum += bench_procfs (file);
+  }
+  procfs_time = g_get_monotonic_time () - start;
+
+  gst_perf_proc_file_close (file);
+
+  /* The sum only keeps the parsing from being optimized away */
+  g_print ("%u reads of /proc/stat (checksum %" G_GUINT64_FORMAT ")\n",
+      iterations, sum);
+  g_print ("stdio:  %.3f us per read\n", 1.0 * stdio_time / iterations);
+  g_print ("procfs: %.3f us per read\n", 1.0 * procfs_time / iterations);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,610 @@
+/* GStreamer
+ * Copyright (C) 2013-2020 RidgeRun, LLC (http://www.ridgerun.com)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * gst-perf-top: live view of every perf instance on the host
+ *
+ * perf elements with shm-export=true publish their reports in
+ * /dev/shm/gst-perf-<pid>, one segment per process. This tool maps the
+ * segments read only and copies the slots under their sequence lock, so
+ * the pipelines never wait for it no matter how often it refreshes.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstperfatomic.h"
+#include "gstperfshm.h"
+
+#include <glib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GST_PERF_TOP_SHM_DIR "/dev/shm"
+#define GST_PERF_TOP_SHM_PREFIX "gst-perf-"
+#define GST_PERF_TOP_MIN_DELAY 0.1
+#define GST_PERF_TOP_NAME_WIDTH 40
+
+/*
+ * A writer that dies in the middle of a write leaves the sequence odd
+ * forever, so readers give up after a few attempts instead of spinning.
+ */
+#define GST_PERF_TOP_READ_ATTEMPTS 100
+
+typedef enum
+{
+  GST_PERF_TOP_STATE_OK,
+  GST_PERF_TOP_STATE_WAITING,
+  GST_PERF_TOP_STATE_IDLE,
+  GST_PERF_TOP_STATE_STALLED
+} GstPerfTopState;
+
+/*
+ * A mapped segment. The file is identified by device and inode, a process
+ * recreates its segment when its perf instances restart and a new process
+ * may reuse the pid of a dead one.
+ */
+typedef struct
+{
+  gint pid;
+  dev_t dev;
+  ino_t ino;
+  gsize size;
+  GstPerfShmHeader *header;
+  guint generation;
+} GstPerfTopSegment;
+
+typedef struct
+{
+  gint pid;
+  GstPerfShmSlot slot;
+  GstPerfTopState state;
+  gint64 since;
+} GstPerfTopRow;
+
+typedef gint (*GstPerfTopCompare) (const GstPerfTopRow * a,
+    const GstPerfTopRow * b);
+
+static gdouble delay = 1.0;
+static gchar *sort_key = NULL;
+static gboolean reverse = FALSE;
+static gint iterations = 0;
+static gboolean batch = FALSE;
+static gint only_pid = 0;
+
+static GstPerfTopCompare compare = NULL;
+
+static GOptionEntry entries[] = {
+  {"delay", 'd', 0, G_OPTION_ARG_DOUBLE, &delay,
+      "Seconds between refreshes, at least 0.1 (default: 1)", "SECONDS"},
+  {"sort", 's', 0, G_OPTION_ARG_STRING, &sort_key,
+        "Sort by pid, name, fps, bitrate, gap, cpu or state (default: pid)",
+      "KEY"},
+  {"reverse", 'r', 0, G_OPTION_ARG_NONE, &reverse,
+      "Reverse the sort order", NULL},
+  {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+      "Exit after this many refreshes, 0 runs forever (default: 0)", "N"},
+  {"batch", 'b', 0, G_OPTION_ARG_NONE, &batch,
+      "Append every refresh instead of redrawing the screen", NULL},
+  {"pid", 'p', 0, G_OPTION_ARG_INT, &only_pid,
+      "Only show the instances of this process", "PID"},
+  {NULL}
+};
+
+static const gchar *state_names[] = {
+  "ok",
+  "waiting",
+  "idle",
+  "STALLED"
+};
+
+/* Same clock as gst_util_get_timestamp(), which stamps the slots, in ns */
+static guint64
+gst_perf_top_get_timestamp (void)
+{
+  return g_get_monotonic_time () * 1000;
+}
+
+static gboolean
+gst_perf_top_process_alive (gint pid)
+{
+  /* EPERM still means there is such a process, owned by someone else */
+  return 0 == kill (pid, 0) || EPERM == errno;
+}
+
+static void
+gst_perf_top_segment_free (gpointer data)
+{
+  GstPerfTopSegment *segment = data;
+
+  munmap (segment->header, segment->size);
+  g_free (segment);
+}
+
+static GstPerfShmSlot *
+gst_perf_top_segment_get_slots (GstPerfTopSegment * segment)
+{
+  return (GstPerfShmSlot *) ((gchar *) segment->header +
+      sizeof (GstPerfShmHeader));
+}
+
+/* Returns NULL until the segment is complete, the magic is written last */
+static GstPerfTopSegment *
+gst_perf_top_segment_open (gint pid)
+{
+  GstPerfTopSegment *segment = NULL;
+  GstPerfShmHeader *header;
+  gchar name[64];
+  struct stat st;
+  gint fd;
+
+  g_snprintf (name, sizeof (name), GST_PERF_SHM_NAME_FORMAT, pid);
+
+  fd = shm_open (name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  if (0 != fstat (fd, &st) || (gsize) st.st_size < sizeof (GstPerfShmHeader)) {
+    close (fd);
+    return NULL;
+  }
+
+  header = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (MAP_FAILED == header) {
+    return NULL;
+  }
+
+  if (0 != memcmp (header->magic, GST_PERF_SHM_MAGIC, sizeof (header->magic))) {
+    goto error;
+  }
+  __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+  if (GST_PERF_SHM_VERSION != header->version) {
+    g_printerr ("Ignoring %s, version %u instead of %u\n", name,
+        header->version, GST_PERF_SHM_VERSION);
+    goto error;
+  }
+
+  if (sizeof (GstPerfShmSlot) != header->slot_size ||
+      (gsize) st.st_size < sizeof (GstPerfShmHeader) +
+      (gsize) header->n_slots * header->slot_size) {
+    g_printerr ("Ignoring %s, unexpected layout\n", name);
+    goto error;
+  }
+
+  segment = g_new0 (GstPerfTopSegment, 1);
+  segment->pid = pid;
+  segment->dev = st.st_dev;
+  segment->ino = st.st_ino;
+  segment->size = st.st_size;
+  segment->header = header;
+
+  return segment;
+
+error:
+  munmap (header, st.st_size);
+  return NULL;
+}
+
+/* Maps the segments that appeared and drops those gone since last time */
+static void
+gst_perf_top_scan (GHashTable * segments, guint generation)
+{
+  GstPerfTopSegment *segment;
+  GHashTableIter iter;
+  const gchar *entry;
+  GDir *dir;
+
+  dir = g_dir_open (GST_PERF_TOP_SHM_DIR, 0, NULL);
+  if (dir) {
+    while ((entry = g_dir_read_name (dir))) {
+      gchar path[sizeof (GST_PERF_TOP_SHM_DIR) + 64];
+      struct stat st;
+      gchar *end;
+      gint64 pid;
+
+      if (!g_str_has_prefix (entry, GST_PERF_TOP_SHM_PREFIX)) {
+        continue;
+      }
+
+      pid = g_ascii_strtoll (entry + strlen (GST_PERF_TOP_SHM_PREFIX), &end,
+          10);
+      if ('\0' != *end || pid <= 0 || pid > G_MAXINT) {
+        continue;
+      }
+
+      if (only_pid && pid != only_pid) {
+        continue;
+      }
+
+      /* A replaced segment is unlinked, its slots are never written again */
+      segment = g_hash_table_lookup (segments, GINT_TO_POINTER (pid));
+      g_snprintf (path, sizeof (path), GST_PERF_TOP_SHM_DIR "/%s", entry);
+      if (segment && (0 != stat (path, &st) || st.st_dev != segment->dev ||
+              st.st_ino != segment->ino)) {
+        g_hash_table_remove (segments, GINT_TO_POINTER (pid));
+        segment = NULL;
+      }
+
+      if (NULL == segment) {
+        segment = gst_perf_top_segment_open (pid);
+        if (NULL == segment) {
+          continue;
+        }
+        g_hash_table_insert (segments, GINT_TO_POINTER (pid), segment);
+      }
+
+      segment->generation = generation;
+    }
+    g_dir_close (dir);
+  }
+
+  /* A crashed process leaves its segment behind, hide it */
+  g_hash_table_iter_init (&iter, segments);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & segment)) {
+    if (segment->generation != generation ||
+        !gst_perf_top_process_alive (segment->pid)) {
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+}
+
+static gboolean
+gst_perf_top_read_slot (GstPerfShmSlot * slot, GstPerfShmSlot * copy)
+{
+  guint sequence;
+  guint i;
+
+  for (i = 0; i < GST_PERF_TOP_READ_ATTEMPTS; i++) {
+    sequence = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1) {
+      g_thread_yield ();
+      continue;
+    }
+
+    memcpy (copy, slot, sizeof (*copy));
+
+    if (!gst_perf_seqlock_read_retry (&slot->sequence, sequence)) {
+      copy->name[sizeof (copy->name) - 1] = '\0';
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+gst_perf_top_set_state (GstPerfTopRow * row, guint64 now)
+{
+  const GstPerfShmSlot *slot = &row->slot;
+
+  row->since = -1;
+
+  if (!(slot->fields & GST_PERF_SHM_HAS_LAST_BUFFER)) {
+    row->state = GST_PERF_TOP_STATE_WAITING;
+    return;
+  }
+
+  row->since = MAX ((gint64) (now - slot->last_arrival), 0);
+
+  if (slot->stall_timeout && row->since >= (gint64) slot->stall_timeout) {
+    row->state = GST_PERF_TOP_STATE_STALLED;
+  } else if (0 == slot->fps) {
+    row->state = GST_PERF_TOP_STATE_IDLE;
+  } else {
+    row->state = GST_PERF_TOP_STATE_OK;
+  }
+}
+
+static void
+gst_perf_top_collect (GHashTable * segments, GArray * rows)
+{
+  GstPerfTopSegment *segment;
+  GHashTableIter iter;
+  guint64 now;
+  guint i;
+
+  g_array_set_size (rows, 0);
+  now = gst_perf_top_get_timestamp ();
+
+  g_hash_table_iter_init (&iter, segments);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & segment)) {
+    GstPerfShmSlot *slots = gst_perf_top_segment_get_slots (segment);
+
+    for (i = 0; i < segment->header->n_slots; i++) {
+      GstPerfTopRow row;
+
+      if (!__atomic_load_n (&slots[i].in_use, __ATOMIC_RELAXED)) {
+        continue;
+      }
+
+      if (!gst_perf_top_read_slot (&slots[i], &row.slot) || !row.slot.in_use) {
+        continue;
+      }
+
+      row.pid = segment->pid;
+      gst_perf_top_set_state (&row, now);
+      g_array_append_val (rows, row);
+    }
+  }
+}
+
+static gint
+gst_perf_top_compare_double (gdouble a, gdouble b)
+{
+  return (a > b) - (a < b);
+}
+
+static gint
+gst_perf_top_compare_pid (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  if (a->pid != b->pid) {
+    return a->pid < b->pid ? -1 : 1;
+  }
+
+  return strcmp (a->slot.name, b->slot.name);
+}
+
+static gint
+gst_perf_top_compare_name (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  gint ret = strcmp (a->slot.name, b->slot.name);
+
+  return ret ? ret : gst_perf_top_compare_pid (a, b);
+}
+
+/* Rates, jitter and load sort the largest first */
+static gint
+gst_perf_top_compare_fps (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  return gst_perf_top_compare_double (b->slot.fps, a->slot.fps);
+}
+
+static gint
+gst_perf_top_compare_bitrate (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  return gst_perf_top_compare_double (b->slot.bps, a->slot.bps);
+}
+
+static gdouble
+gst_perf_top_get_gap (const GstPerfTopRow * row)
+{
+  return row->slot.fields & GST_PERF_SHM_HAS_GAP ?
+      (gdouble) row->slot.gap_p99 : -1;
+}
+
+static gint
+gst_perf_top_compare_gap (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  return gst_perf_top_compare_double (gst_perf_top_get_gap (b),
+      gst_perf_top_get_gap (a));
+}
+
+static gdouble
+gst_perf_top_get_cpu (const GstPerfTopRow * row)
+{
+  return row->slot.fields & GST_PERF_SHM_HAS_THREAD_CPU ?
+      row->slot.thread_cpu : -1;
+}
+
+static gint
+gst_perf_top_compare_cpu (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  return gst_perf_top_compare_double (gst_perf_top_get_cpu (b),
+      gst_perf_top_get_cpu (a));
+}
+
+/* Stalled streams first, the longest stalled on top */
+static gint
+gst_perf_top_compare_state (const GstPerfTopRow * a, const GstPerfTopRow * b)
+{
+  if (a->state != b->state) {
+    return a->state > b->state ? -1 : 1;
+  }
+
+  if (a->since != b->since) {
+    return a->since > b->since ? -1 : 1;
+  }
+
+  return gst_perf_top_compare_pid (a, b);
+}
+
+static gint
+gst_perf_top_compare_rows (gconstpointer a, gconstpointer b)
+{
+  gint ret = compare (a, b);
+
+  return reverse ? -ret : ret;
+}
+
+static GstPerfTopCompare
+gst_perf_top_get_compare (const gchar * key)
+{
+  static const struct
+  {
+    const gchar *key;
+    GstPerfTopCompare compare;
+  } keys[] = {
+    {"pid", gst_perf_top_compare_pid},
+    {"name", gst_perf_top_compare_name},
+    {"fps", gst_perf_top_compare_fps},
+    {"bitrate", gst_perf_top_compare_bitrate},
+    {"gap", gst_perf_top_compare_gap},
+    {"cpu", gst_perf_top_compare_cpu},
+    {"state", gst_perf_top_compare_state},
+  };
+  guint i;
+
+  if (NULL == key) {
+    return gst_perf_top_compare_pid;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+    if (0 == g_ascii_strcasecmp (key, keys[i].key)) {
+      return keys[i].compare;
+    }
+  }
+
+  return NULL;
+}
+
+/* Keeps the end of long paths, the element name is the useful part */
+static const gchar *
+gst_perf_top_short_name (const gchar * name)
+{
+  gsize len = strlen (name);
+
+  if (len <= GST_PERF_TOP_NAME_WIDTH) {
+    return name;
+  }
+
+  return name + len - (GST_PERF_TOP_NAME_WIDTH - 3);
+}
+
+static void
+gst_perf_top_print (GHashTable * segments, GArray * rows)
+{
+  GDateTime *now;
+  gchar *time;
+  guint i;
+
+  if (!batch) {
+    /* Home and clear screen */
+    fputs ("\033[H\033[2J", stdout);
+  }
+
+  now = g_date_time_new_now_local ();
+  time = g_date_time_format (now, "%H:%M:%S");
+  printf ("gst-perf-top - %s, %u processes, %u instances\n\n", time,
+      g_hash_table_size (segments), rows->len);
+  g_free (time);
+  g_date_time_unref (now);
+
+  printf ("%7s %-*s %8s %8s %10s %8s %7s %-7s %6s\n", "PID",
+      GST_PERF_TOP_NAME_WIDTH, "ELEMENT", "FPS", "MEANFPS", "KBPS",
+      "GAP99MS", "THREAD%", "STATE", "IDLE");
+
+  for (i = 0; i < rows->len; i++) {
+    const GstPerfTopRow *row = &g_array_index (rows, GstPerfTopRow, i);
+    const GstPerfShmSlot *slot = &row->slot;
+    const gchar *name = gst_perf_top_short_name (slot->name);
+    gchar gap[16] = "-", cpu[16] = "-", since[16] = "-";
+
+    if (slot->fields & GST_PERF_SHM_HAS_GAP) {
+      g_snprintf (gap, sizeof (gap), "%.1f", slot->gap_p99 / 1e6);
+    }
+
+    if (slot->fields & GST_PERF_SHM_HAS_THREAD_CPU) {
+      g_snprintf (cpu, sizeof (cpu), "%.1f", slot->thread_cpu);
+    }
+
+    if (row->since >= 0) {
+      g_snprintf (since, sizeof (since), "%.1fs",
+          row->since / 1e9);
+    }
+
+    printf ("%7d %s%-*s %8.2f %8.2f %10.1f %8s %7s %-7s %6s\n", row->pid,
+        name == slot->name ? "" : "...",
+        GST_PERF_TOP_NAME_WIDTH - (name == slot->name ? 0 : 3), name,
+        slot->fps, slot->mean_fps, slot->bps / 1000, gap, cpu,
+        state_names[row->state], since);
+  }
+
+  if (batch) {
+    putchar ('\n');
+  }
+
+  fflush (stdout);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *context;
+  GHashTable *segments;
+  GArray *rows;
+  GError *error = NULL;
+  guint generation;
+
+  context = g_option_context_new ("- live view of the perf instances");
+  g_option_context_set_summary (context,
+      "Shows the latest report of every perf element exporting its "
+      "statistics,\nthat is with shm-export=true, in every process.");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    g_option_context_free (context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free (context);
+
+  if (iterations < 0) {
+    g_printerr ("The number of iterations can't be negative\n");
+    return EXIT_FAILURE;
+  }
+
+  compare = gst_perf_top_get_compare (sort_key);
+  if (NULL == compare) {
+    g_printerr ("Unknown sort key %s\n", sort_key);
+    return EXIT_FAILURE;
+  }
+
+  /* Refreshing faster than 10 Hz is unreadable anyway */
+  if (delay < GST_PERF_TOP_MIN_DELAY) {
+    delay = GST_PERF_TOP_MIN_DELAY;
+  }
+
+  if (!batch && !isatty (STDOUT_FILENO)) {
+    batch = TRUE;
+  }
+
+  segments = g_hash_table_new_full (NULL, NULL, NULL,
+      gst_perf_top_segment_free);
+  rows = g_array_new (FALSE, FALSE, sizeof (GstPerfTopRow));
+
+  for (generation = 1; 0 == iterations || generation <= (guint) iterations;
+      generation++) {
+    if (generation > 1) {
+      g_usleep (delay * G_USEC_PER_SEC);
+    }
+
+    gst_perf_top_scan (segments, generation);
+    gst_perf_top_collect (segments, rows);
+    g_array_sort (rows, gst_perf_top_compare_rows);
+    gst_perf_top_print (segments, rows);
+  }
+
+  g_array_free (rows, TRUE);
+  g_hash_table_destroy (segments);
+  g_free (sort_key);
+
+  return EXIT_SUCCESS;
+}